@@ -0,0 +1,224 @@
+/*
+ * ara.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Anytime search (ARA*). A pass expands states in order of cost + weight * heuristic until no state
+ * in the frontier has a key below the cost of the best solution so far. A state is expanded at most
+ * once per pass: one reached again with a lower cost after it was expanded is kept aside in the
+ * inconsistent list, and joins the frontier only when the next pass starts with a lower weight.
+ * States are never thrown away between passes, so a pass redoes only the part of the search the
+ * new weight changes.
+ * 
+ * Every state on the way to an optimal solution that isn't expanded with its lowest cost yet is in
+ * the frontier or in the inconsistent list, so with an admissible heuristic the lowest
+ * cost + heuristic over both is a lower bound of the optimum, and the ratio of the best solution to
+ * it bounds how far off it is. States with a cost + heuristic no lower than the best solution are
+ * dropped, and the optimum is proven once none are left.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ara.h"
+
+u_int weighted_heuristic(Ara *ara, u_int heuristic) {
+   return (heuristic * ara->weight + 9) / 10;
+}
+
+_Bool closed_state(Ara *ara, u_int state_id) {
+   if (state_id >= ara->expanded_capacity)
+      return False;
+   return (ara->expanded[state_id] == ara->pass) || (ara->expanded[state_id] == ARA_INCONSISTENT);
+}
+
+int defer_state(Ara *ara, u_int state_id) {
+   if (ara->expanded[state_id] == ARA_INCONSISTENT)
+      return 0;
+   if (ara->num_inconsistent == ara->inconsistent_capacity) {
+      u_int new_capacity = ara->inconsistent_capacity * 2;
+      u_int *temp = realloc(ara->inconsistent, sizeof(u_int) * new_capacity);
+      if (temp == NULL)
+         return 1;
+      ara->inconsistent = temp;
+      ara->inconsistent_capacity = new_capacity;
+   }
+   ara->inconsistent[ara->num_inconsistent++] = state_id;
+   ara->expanded[state_id] = ARA_INCONSISTENT;
+   return 0;
+}
+
+static int mark_expanded(Ara *ara, u_int state_id) {
+   if (state_id >= ara->expanded_capacity) {
+      u_int new_capacity = ara->expanded_capacity * 2;
+      while (new_capacity <= state_id)
+         new_capacity *= 2;
+      u_int *temp = realloc(ara->expanded, sizeof(u_int) * new_capacity);
+      if (temp == NULL)
+         return 1;
+      memset(temp + ara->expanded_capacity, 0, sizeof(u_int) * (new_capacity - ara->expanded_capacity));
+      ara->expanded = temp;
+      ara->expanded_capacity = new_capacity;
+   }
+   ara->expanded[state_id] = ara->pass;
+   return 0;
+}
+
+static int init_ara(Ara *ara, double weight) {
+   memset(ara, 0, sizeof(Ara));
+   ara->weight = (weight * 10 + 0.5);
+   ara->pass = 1;
+   ara->expanded_capacity = 1024;
+   ara->inconsistent_capacity = 1024;
+   ara->expanded = calloc(ara->expanded_capacity, sizeof(u_int));
+   ara->inconsistent = malloc(sizeof(u_int) * ara->inconsistent_capacity);
+   ara->solution = NO_STATE;
+   ara->solution_cost = UINT_MAX;
+   if ((ara->expanded == NULL) || (ara->inconsistent == NULL))
+      return 1;
+   return 0;
+}
+
+static void free_ara(Ara *ara) {
+   free(ara->expanded);
+   free(ara->inconsistent);
+}
+
+// expands states until the best solution can't be improved at the current weight.
+// returns 1 if the search was stopped
+static int improve_solution(Search *search) {
+   Ara *ara = search->ara;
+   
+   while ((search->states->length > 0) && (min_key_pqueue(search->states) < ara->solution_cost)) {
+      u_int state_id = remove_min_pqueue(search->states);
+      State *state = get_state(search, state_id);
+      
+      if (state->cost_score + state->heuristic_score >= ara->solution_cost)
+         continue;
+      if (mark_expanded(ara, state_id)) {
+         search->stopped = SEARCH_OUT_OF_MEMORY;
+         return 1;
+      }
+      if (state->heuristic_score == 0) {
+         ara->solution = state_id;
+         ara->solution_cost = state->cost_score;
+         continue;
+      }
+      if ((search->nodes % LIMIT_CHECK_INTERVAL == 0) && over_limits(search))
+         return 1;
+      if (search->expand_func(search, state_id)) {
+         search->stopped = SEARCH_OUT_OF_MEMORY;
+         return 1;
+      }
+      search->nodes++;
+   }
+   return 0;
+}
+
+// starts the next pass at weight: the frontier and the inconsistent states are queued again with
+// the new keys, except those that can't lead to a better solution. *lowest gets the lowest
+// cost + heuristic among them, UINT_MAX if there are none
+static int next_pass(Search *search, u_int weight, u_int *lowest) {
+   Ara *ara = search->ara;
+   u_int num_states = 0;
+   u_int *states = malloc(sizeof(u_int) * (search->states->length + ara->num_inconsistent + 1));
+   if (states == NULL)
+      return 1;
+   
+   u_int state_id;
+   while ((state_id = remove_min_pqueue(search->states)) != PQ_ABSENT)
+      states[num_states++] = state_id;
+   for (u_int i = 0; i < ara->num_inconsistent; i++) {
+      states[num_states++] = ara->inconsistent[i];
+      ara->expanded[ara->inconsistent[i]] = 0;
+   }
+   ara->num_inconsistent = 0;
+   ara->weight = weight;
+   ara->pass++;
+   
+   *lowest = UINT_MAX;
+   for (u_int i = 0; i < num_states; i++) {
+      State *state = get_state(search, states[i]);
+      u_int score = state->cost_score + state->heuristic_score;
+      if (score >= ara->solution_cost)
+         continue;
+      if (score < *lowest)
+         *lowest = score;
+      if (insert_pqueue(search->states, states[i], state->cost_score, weighted_heuristic(ara, state->heuristic_score))) {
+         free(states);
+         return 1;
+      }
+   }
+   free(states);
+   return 0;
+}
+
+static int print_solution(Search *search, double bound) {
+   Ara *ara = search->ara;
+   char *moves = solution_moves(search, ara->solution);
+   if (moves == NULL)
+      return 1;
+   printf("Solution of cost %u within %.2f times the optimum after %lu nodes\n%s\n",
+          ara->solution_cost, bound, search->nodes, moves);
+   fflush(stdout);
+   free(moves);
+   return 0;
+}
+
+u_int ara_search(Search *search, double weight) {
+   Ara ara;
+   if (init_ara(&ara, weight)) {
+      free_ara(&ara);
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+      return NO_STATE;
+   }
+   search->ara = &ara;
+   search->nodes = 1;
+   
+   // the root was queued without the weight
+   u_int lowest;
+   int failed = next_pass(search, ara.weight, &lowest);
+   
+   while (!failed) {
+      u_int previous = ara.solution;
+      u_int pass_weight = ara.weight;
+      if (improve_solution(search))
+         break;
+      
+      u_int new_weight = (pass_weight > 10 + ARA_WEIGHT_STEP) ? pass_weight - ARA_WEIGHT_STEP : 10;
+      if ((failed = next_pass(search, new_weight, &lowest)))
+         break;
+      if (ara.solution == NO_STATE)
+         break;
+      
+      double bound = (lowest == UINT_MAX) ? 1.0 : (double) ara.solution_cost / lowest;
+      if (bound > pass_weight / 10.0)
+         bound = pass_weight / 10.0;
+      if ((ara.solution != previous) && !search->quiet && (failed = print_solution(search, bound)))
+         break;
+      if (lowest == UINT_MAX) {
+         if (!search->quiet)
+            printf("Cost %u proven optimal after %lu nodes\n", ara.solution_cost, search->nodes);
+         break;
+      }
+   }
+   if (failed)
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+   
+   search->ara = NULL;
+   free_ara(&ara);
+   return ara.solution;
+}
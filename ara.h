@@ -0,0 +1,39 @@
+#ifndef ARA_H
+#define ARA_H
+
+#include "sokoban.h"
+
+#define ARA_DEFAULT_WEIGHT 3.0
+#define ARA_WEIGHT_STEP 5         // tenths the weight is lowered by after every pass
+#define ARA_INCONSISTENT UINT_MAX // expanded pass of a state waiting in the inconsistent list
+
+// anytime repairing A*: passes of a weighted search, the frontier ordered by cost + weight * heuristic.
+// every pass stops once the best solution so far can't be improved at its weight, then the weight
+// is lowered and the next pass goes on from the states left over instead of starting again
+typedef struct ara {
+   u_int weight;           // weight of the heuristic in the frontier keys, in tenths
+   u_int pass;             // states expanded in the current pass are closed
+   u_int *expanded;        // pass each state was last expanded in by id, 0 for never
+   u_int expanded_capacity;
+   u_int *inconsistent;    // closed states reached again with a lower cost, expanded again next pass
+   u_int num_inconsistent;
+   u_int inconsistent_capacity;
+   u_int solution;         // best solution so far, NO_STATE if none
+   u_int solution_cost;    // its cost, UINT_MAX if none
+} Ara;
+
+// searches from the states in the frontier starting with the given weight on the heuristic.
+// every better solution is printed with its bound on the ratio to the optimal cost unless the
+// search is quiet. returns the best solution found before the limits or the optimum was reached
+u_int ara_search(Search *search, double weight);
+
+// heuristic part of the frontier key at the weight of the current pass
+u_int weighted_heuristic(Ara *ara, u_int heuristic);
+
+// whether state_id was expanded in the current pass or is waiting for the next one
+_Bool closed_state(Ara *ara, u_int state_id);
+
+// puts the closed state_id, reached again with a lower cost, aside for the next pass
+int defer_state(Ara *ara, u_int state_id);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * arena.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define BLOCK_RECORDS (1U << ARENA_BLOCK_BITS)
+
+u_int alloc_arena(Arena *ptr) {
+   if (ptr->length == ARENA_NULL)
+      return ARENA_NULL;
+   
+   u_int block = ptr->length >> ARENA_BLOCK_BITS;
+   if (block == ptr->num_blocks) {
+      if (ptr->num_blocks == ptr->blocks_capacity) {
+         u_int new_capacity = (ptr->blocks_capacity == 0) ? 16 : ptr->blocks_capacity * 2;
+         u_char **blocks = realloc(ptr->blocks, sizeof(u_char *) * new_capacity);
+         if (blocks == NULL)
+            return ARENA_NULL;
+         ptr->blocks = blocks;
+         ptr->blocks_capacity = new_capacity;
+      }
+      ptr->blocks[block] = calloc(BLOCK_RECORDS, ptr->stride);
+      if (ptr->blocks[block] == NULL)
+         return ARENA_NULL;
+      ptr->num_blocks++;
+   }
+   
+   return ptr->length++;
+}
+
+void truncate_arena(Arena *ptr, u_int length) {
+   for (u_int i = length; i < ptr->length; i++)
+      memset(get_arena(ptr, i), 0, ptr->stride);
+   if (length < ptr->length)
+      ptr->length = length;
+}
+
+void reset_arena(Arena *ptr, u_int stride) {
+   if (stride == ptr->stride) {
+      truncate_arena(ptr, 0);
+      return;
+   }
+   for (u_int i = 0; i < ptr->num_blocks; i++)
+      free(ptr->blocks[i]);
+   ptr->num_blocks = 0;
+   ptr->length = 0;
+   ptr->stride = stride;
+}
+
+size_t size_arena(Arena *ptr) {
+   return (size_t) ptr->num_blocks * BLOCK_RECORDS * ptr->stride + ptr->blocks_capacity * sizeof(u_char *);
+}
+
+void free_arena(Arena *ptr) {
+   for (u_int i = 0; i < ptr->num_blocks; i++)
+      free(ptr->blocks[i]);
+   free(ptr->blocks);
+   free(ptr);
+}
+
+int init_arena(Arena **ptr, u_int stride) {
+   *ptr = calloc(1, sizeof(Arena));
+   if (*ptr == NULL)
+      return 1;
+   
+   (*ptr)->stride = stride;
+   return 0;
+}
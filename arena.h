@@ -0,0 +1,44 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <limits.h>
+#include "types.h"
+
+#define ARENA_BLOCK_BITS 16    // records per block = 2^ARENA_BLOCK_BITS
+#define ARENA_NULL UINT_MAX
+
+// fixed stride records allocated contiguously in large blocks and addressed by a 32 bit index.
+// blocks are never moved, so a pointer to a record stays valid until the arena is freed
+typedef struct {
+   u_char **blocks;
+   u_int num_blocks;
+   u_int blocks_capacity;
+   u_int stride;
+   u_int length;
+} Arena;
+
+int init_arena(Arena **ptr, u_int stride);
+
+// returns the index of a new zeroed record, ARENA_NULL if out of memory
+u_int alloc_arena(Arena *ptr);
+
+static inline void *get_arena(Arena *ptr, u_int index) {
+   return ptr->blocks[index >> ARENA_BLOCK_BITS] +
+            (size_t) (index & ((1U << ARENA_BLOCK_BITS) - 1)) * ptr->stride;
+}
+
+// drops every record from index length on, they are zeroed and handed out again by alloc_arena.
+// the blocks are kept, so the arena can be used as a stack
+void truncate_arena(Arena *ptr, u_int length);
+
+// drops every record to hold records of stride bytes from now on. the blocks are kept when the stride
+// doesn't change, so that an arena reused for another puzzle doesn't allocate them again
+void reset_arena(Arena *ptr, u_int stride);
+
+// total bytes held by the arena
+size_t size_arena(Arena *ptr);
+
+void free_arena(Arena *ptr);
+
+#endif
@@ -0,0 +1,392 @@
+/*
+ * batch.c Copyright (C) 2019 Orpheas van Rooij
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Batch mode: every puzzle of a collection is read up front, then a pool of threads solves them,
+ * each thread with a solver context of its own (see solver.h) that takes its puzzles one at a time.
+ * The puzzles are dealt round robin to the workers. A worker takes its next puzzle from the tail of its
+ * own queue and, once that is empty, steals from the head of the queues of the others, so a few hard
+ * puzzles don't keep the rest waiting.
+ * A result line is printed as soon as a puzzle is done, so the lines are in order of completion:
+ *
+ *    name  status  length  nodes  milliseconds  moves
+ *
+ * separated by tabs, where status is solved, unsolved, timeout, memory or invalid (the last column
+ * then holds the reason). The dead windows learned by a puzzle are passed on to the ones after it.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // opendir, stat, open
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "batch.h"
+
+#define NO_JOB UINT_MAX
+
+static char *copy_string(const char *str) {
+   char *copy = malloc(strlen(str) + 1);
+   if (copy != NULL)
+      strcpy(copy, str);
+   return copy;
+}
+
+// keeps the text of the puzzle read from begin to the position of file
+static int copy_text(Job *job, LevelFile *file, size_t begin) {
+   job->length = file->pos - begin;
+   if (NULL == (job->text = malloc(job->length)))
+      return 1;
+   memcpy(job->text, file->data + begin, job->length);
+   return 0;
+}
+
+// reads every puzzle of the file path, a file that can't be parsed stops at its first invalid puzzle.
+// the puzzles are only checked here, each is read again from its text by the solver of its worker
+static int read_file(BatchRun *run, const char *path, const char *name, u_int *capacity) {
+   LevelFile file;
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return BATCH_NO_INPUT;
+   int failed = open_levels(&file, fd);
+   close(fd);
+   if (failed)
+      return BATCH_NO_INPUT;
+   
+   u_int first = run->num_jobs;
+   int ret = 0;
+   while (ret == 0) {
+      if (run->num_jobs == *capacity) {
+         Job *jobs = realloc(run->jobs, sizeof(Job) * *capacity * 2);
+         if (jobs == NULL) {
+            ret = BATCH_NO_MEMORY;
+            break;
+         }
+         run->jobs = jobs;
+         *capacity *= 2;
+      }
+      Job *job = &run->jobs[run->num_jobs];
+      memset(job, 0, sizeof(Job));
+      
+      Level level;
+      Coordinate start, *boxes;
+      size_t begin = file.pos;
+      job->status = read_level(&file, &level, &start, &boxes, job->error);
+      if (job->status == LEVEL_END)
+         break;
+      if (job->status == LEVEL_OK) {
+         free_level(&level);
+         free(boxes);
+         if (copy_text(job, &file, begin))
+            ret = BATCH_NO_MEMORY;
+      }
+      run->num_jobs++;
+      if (job->status == LEVEL_INVALID)
+         break;
+   }
+   close_levels(&file);
+   if (ret != 0)
+      return ret;
+   
+   u_int count = run->num_jobs - first;
+   for (u_int i = 0; i < count; i++) {
+      Job *job = &run->jobs[first + i];
+      job->name = malloc(strlen(name) + 12);
+      if (job->name == NULL)
+         return BATCH_NO_MEMORY;
+      if (count == 1)
+         strcpy(job->name, name);
+      else
+         sprintf(job->name, "%s:%u", name, i + 1);
+   }
+   return 0;
+}
+
+static int compare_names(const void *a, const void *b) {
+   return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// reads the puzzles of every file in the directory path, in order of file name
+static int read_directory(BatchRun *run, const char *path, u_int *capacity) {
+   DIR *dir = opendir(path);
+   if (dir == NULL)
+      return BATCH_NO_INPUT;
+   
+   u_int num_names = 0, names_capacity = 64;
+   char **names = malloc(sizeof(char *) * names_capacity);
+   int ret = (names == NULL) ? BATCH_NO_MEMORY : 0;
+   
+   struct dirent *entry;
+   while ((ret == 0) && (entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] == '.')
+         continue;
+      if (num_names == names_capacity) {
+         char **more = realloc(names, sizeof(char *) * names_capacity * 2);
+         if (more == NULL) {
+            ret = BATCH_NO_MEMORY;
+            break;
+         }
+         names = more;
+         names_capacity *= 2;
+      }
+      if (NULL == (names[num_names] = copy_string(entry->d_name)))
+         ret = BATCH_NO_MEMORY;
+      else
+         num_names++;
+   }
+   closedir(dir);
+   if (ret == 0)
+      qsort(names, num_names, sizeof(char *), compare_names);
+   
+   char *file_path = malloc(strlen(path) + NAME_MAX + 2);
+   if (file_path == NULL)
+      ret = BATCH_NO_MEMORY;
+   for (u_int i = 0; i < num_names; i++) {
+      struct stat info;
+      if (ret == 0) {
+         sprintf(file_path, "%s/%s", path, names[i]);
+         if ((stat(file_path, &info) == 0) && S_ISREG(info.st_mode))
+            ret = read_file(run, file_path, names[i], capacity);
+      }
+      free(names[i]);
+   }
+   free(file_path);
+   free(names);
+   return ret;
+}
+
+// next puzzle for worker: its own latest, or else the oldest of another worker
+static u_int next_job(BatchWorker *worker) {
+   BatchRun *run = worker->run;
+   u_int job = NO_JOB;
+   
+   JobQueue *own = &worker->queue;
+   pthread_mutex_lock(&own->lock);
+   if (own->tail > own->head)
+      job = own->jobs[--own->tail];
+   pthread_mutex_unlock(&own->lock);
+   
+   for (u_int i = 1; (job == NO_JOB) && (i < run->num_threads); i++) {
+      JobQueue *victim = &run->workers[(worker->index + i) % run->num_threads].queue;
+      pthread_mutex_lock(&victim->lock);
+      if (victim->tail > victim->head) {
+         job = victim->jobs[victim->head++];
+         worker->stolen++;
+      }
+      pthread_mutex_unlock(&victim->lock);
+   }
+   return job;
+}
+
+static void print_result(BatchRun *run, Job *job, const char *status, u_int length, unsigned long nodes,
+                         double seconds, const char *moves) {
+   pthread_mutex_lock(&run->output_lock);
+   printf("%s\t%s\t%u\t%lu\t%.0f\t%s\n", job->name, status, length, nodes, seconds * 1000, moves);
+   fflush(stdout);
+   pthread_mutex_unlock(&run->output_lock);
+}
+
+// solves one puzzle with the solver of worker and prints its result line, returns whether it was solved
+static _Bool solve_job(BatchWorker *worker, Job *job) {
+   BatchRun *run = worker->run;
+   Solver *solver = worker->solver;
+   double started = now_seconds();
+   
+   if (job->status != LEVEL_OK) {
+      print_result(run, job, "invalid", 0, 0, 0, job->error);
+      return False;
+   }
+   
+   int failed = 0;
+   if (run->patterns != NULL) {
+      pthread_mutex_lock(&run->patterns_lock);
+      failed = import_solver_patterns(solver, run->patterns);
+      pthread_mutex_unlock(&run->patterns_lock);
+   }
+   int result = failed ? SOLVER_NO_MEMORY : solve_puzzle(solver, job->text, job->length);
+   double seconds = now_seconds() - started;
+   
+   const char *moves = "-";
+   u_int length = 0;
+   switch (result) {
+      case (SOLVER_SOLVED):
+         moves = solver_moves(solver);
+         length = count_moves(moves);
+         print_result(run, job, "solved", length, solver_nodes(solver), seconds, moves);
+         break;
+      case (SOLVER_INVALID):
+         print_result(run, job, "invalid", 0, 0, seconds, solver_error(solver));
+         break;
+      case (SOLVER_UNSOLVABLE):
+         print_result(run, job, "unsolved", 0, solver_nodes(solver), seconds, moves);
+         break;
+      case (SOLVER_TIME_LIMIT):
+         print_result(run, job, "timeout", 0, solver_nodes(solver), seconds, moves);
+         break;
+      default:
+         print_result(run, job, "memory", 0, solver_nodes(solver), seconds, moves);
+   }
+   
+   pthread_mutex_lock(&run->output_lock);
+   if ((result == SOLVER_SOLVED) && (solver_error(solver)[0] != 0))
+      fprintf(stderr, "%s\n", solver_error(solver));
+   if (run->options->stats)
+      print_solver_stats(solver, stderr, job->name);
+   pthread_mutex_unlock(&run->output_lock);
+   
+   // a dead window that can't be passed on only costs the later puzzles some time
+   if ((run->patterns != NULL) && (result != SOLVER_INVALID)) {
+      pthread_mutex_lock(&run->patterns_lock);
+      export_solver_patterns(solver, run->patterns);
+      pthread_mutex_unlock(&run->patterns_lock);
+   }
+   return result == SOLVER_SOLVED;
+}
+
+static void *run_worker(void *arg) {
+   BatchWorker *worker = arg;
+   u_int job;
+   
+   while ((job = next_job(worker)) != NO_JOB)
+      worker->solved += solve_job(worker, &worker->run->jobs[job]);
+   return NULL;
+}
+
+// frees everything run_batch set up, whether the run got to start or not
+static void free_run(BatchRun *run) {
+   for (u_int i = 0; i < run->num_jobs; i++) {
+      free(run->jobs[i].name);
+      free(run->jobs[i].text);
+   }
+   free(run->jobs);
+   if (run->workers != NULL) {
+      for (u_int i = 0; i < run->num_threads; i++) {
+         BatchWorker *worker = &run->workers[i];
+         if (worker->solver != NULL)
+            free_solver(worker->solver);
+         free(worker->queue.jobs);
+         pthread_mutex_destroy(&worker->queue.lock);
+      }
+      free(run->workers);
+   }
+   free_patterns(run->patterns);
+   pthread_mutex_destroy(&run->output_lock);
+   pthread_mutex_destroy(&run->patterns_lock);
+}
+
+// reads the puzzles and gives every worker its queue and its solver
+static int setup_run(BatchRun *run, const char *path, u_int num_threads, const char *pattern_file) {
+   u_int capacity = 64;
+   struct stat info;
+   if (NULL == (run->jobs = malloc(sizeof(Job) * capacity)))
+      return BATCH_NO_MEMORY;
+   if (stat(path, &info) != 0)
+      return BATCH_NO_INPUT;
+   int ret = S_ISDIR(info.st_mode) ? read_directory(run, path, &capacity) : read_file(run, path, path, &capacity);
+   if (ret != 0)
+      return ret;
+   if (run->num_jobs == 0)
+      return BATCH_NO_PUZZLE;
+   
+   if (pattern_file != NULL) {
+      if (init_patterns(&run->patterns))
+         return BATCH_NO_MEMORY;
+      if (load_patterns(run->patterns, pattern_file))
+         return BATCH_NO_PATTERNS;
+   }
+   
+   run->num_threads = (num_threads < run->num_jobs) ? num_threads : run->num_jobs;
+   if (run->num_threads == 0)
+      run->num_threads = 1;
+   if (NULL == (run->workers = calloc(run->num_threads, sizeof(BatchWorker))))
+      return BATCH_NO_MEMORY;
+   for (u_int i = 0; i < run->num_threads; i++)
+      pthread_mutex_init(&run->workers[i].queue.lock, NULL);
+   
+   // worker i gets puzzles i, i + threads, ... stored last to first, so that it takes them in order
+   // and the others steal the puzzles at the end of the collection first
+   for (u_int i = 0; i < run->num_threads; i++) {
+      BatchWorker *worker = &run->workers[i];
+      worker->run = run;
+      worker->index = i;
+      worker->queue.tail = (run->num_jobs + run->num_threads - 1 - i) / run->num_threads;
+      if (NULL == (worker->queue.jobs = malloc(sizeof(u_int) * (worker->queue.tail + 1))))
+         return BATCH_NO_MEMORY;
+      for (u_int j = 0; j < worker->queue.tail; j++)
+         worker->queue.jobs[worker->queue.tail - 1 - j] = i + j * run->num_threads;
+      if (init_solver(&worker->solver, run->options)) {
+         worker->solver = NULL;
+         return BATCH_NO_MEMORY;
+      }
+   }
+   return 0;
+}
+
+int run_batch(const char *path, Options *options, u_int num_threads, const char *pattern_file) {
+   BatchRun run;
+   memset(&run, 0, sizeof(BatchRun));
+   pthread_mutex_init(&run.output_lock, NULL);
+   pthread_mutex_init(&run.patterns_lock, NULL);
+   
+   Options batch_options = *options;
+   batch_options.verbose = False;   // the states of parallel searches would be interleaved
+   batch_options.quiet = True;
+   batch_options.num_threads = 1;   // the threads solve puzzles side by side, not one puzzle together
+   run.options = &batch_options;
+   
+   int ret = setup_run(&run, path, num_threads, pattern_file);
+   if (ret != 0) {
+      free_run(&run);
+      return ret;
+   }
+   
+   // a worker that can't be started leaves its puzzles to be stolen by the others
+   double started = now_seconds();
+   u_int num_started = 0;
+   while ((num_started < run.num_threads) &&
+      (pthread_create(&run.workers[num_started].thread, NULL, run_worker, &run.workers[num_started]) == 0))
+      num_started++;
+   for (u_int i = 0; i < num_started; i++)
+      pthread_join(run.workers[i].thread, NULL);
+   double elapsed = now_seconds() - started;
+   if (num_started == 0) {
+      free_run(&run);
+      return BATCH_NO_THREAD;
+   }
+   
+   unsigned long solved = 0;
+   for (u_int i = 0; i < run.num_threads; i++) {
+      BatchWorker *worker = &run.workers[i];
+      fprintf(stderr, "thread %u: %lu solved, %lu stolen\n", i, worker->solved, worker->stolen);
+      solved += worker->solved;
+   }
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   fprintf(stderr, "%lu of %u puzzles solved in %.1f s, %.0f puzzles per hour, peak memory %ld kB\n", solved,
+           run.num_jobs, elapsed, (elapsed > 0) ? run.num_jobs * 3600 / elapsed : 0, usage.ru_maxrss);
+   
+   if ((pattern_file != NULL) && save_patterns(run.patterns, pattern_file))
+      fprintf(stderr, "Could not write deadlock pattern file %s\n", pattern_file);
+   
+   ret = (solved == run.num_jobs) ? BATCH_SOLVED : BATCH_UNSOLVED;
+   free_run(&run);
+   return ret;
+}
@@ -0,0 +1,65 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+#include "sokoban.h"
+#include "pattern.h"
+#include "solver.h"
+
+#define BATCH_MAX_THREADS 64
+
+// return codes of run_batch
+#define BATCH_SOLVED 0
+#define BATCH_UNSOLVED 1        // some puzzle wasn't solved, its result line tells why
+#define BATCH_NO_MEMORY 2
+#define BATCH_NO_INPUT 3        // the file or directory can't be read
+#define BATCH_NO_PATTERNS 4     // the deadlock pattern file can't be read
+#define BATCH_NO_THREAD 5
+#define BATCH_NO_PUZZLE 6       // the file or directory holds no puzzle at all
+
+// one puzzle of the collection, read before the workers start
+typedef struct {
+   char *name;             // file name, followed by :k for the k-th puzzle of a file holding several
+   int status;             // return code of read_level
+   char error[LEVEL_ERROR_SIZE];
+   char *text;             // the lines of the puzzle, handed to solve_puzzle
+   size_t length;
+} Job;
+
+// puzzles waiting for a worker, the owner takes from the tail and the other workers steal from the head
+typedef struct {
+   u_int *jobs;
+   u_int head;
+   u_int tail;
+   pthread_mutex_t lock;
+} JobQueue;
+
+typedef struct batch_worker {
+   struct batch_run *run;
+   JobQueue queue;
+   Solver *solver;         // kept from one puzzle of the worker to the next
+   pthread_t thread;
+   u_int index;
+   unsigned long solved;
+   unsigned long stolen;
+} BatchWorker;
+
+// a collection of puzzles solved by a pool of threads, each puzzle by a single threaded solver
+typedef struct batch_run {
+   Job *jobs;
+   u_int num_jobs;
+   BatchWorker *workers;
+   u_int num_threads;
+   Options *options;
+   
+   pthread_mutex_t output_lock;  // one result line is printed at a time
+   Patterns *patterns;           // dead windows learned by the puzzles solved so far, NULL if not kept
+   pthread_mutex_t patterns_lock;
+} BatchRun;
+
+// solves every puzzle of the file or directory path with num_threads threads, printing one line per
+// puzzle as soon as it is done. the dead windows learned are kept in pattern_file unless it is NULL.
+// returns one of the BATCH_ codes
+int run_batch(const char *path, Options *options, u_int num_threads, const char *pattern_file);
+
+#endif
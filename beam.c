@@ -0,0 +1,217 @@
+/*
+ * beam.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Beam search. Every state of a depth is expanded, the children are appended to the arena behind
+ * them, and once the depth is done the width best children by heuristic are moved down to the
+ * front and the rest dropped, so the arena never holds more than width states per depth plus the
+ * children of one depth. Children are looked up in a table of the children of their depth and in
+ * the state table, which holds the states kept at the depths before, both of the same bounded size.
+ * 
+ * The solution is the first child found with every box on a goal position, it is not optimal.
+ * When a beam runs out of states the search starts over with a wider one, unless no child was
+ * dropped, in which case every reachable state has been seen and the puzzle has no solution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "beam.h"
+
+typedef struct {
+   u_int heuristic;
+   u_int index;
+} Candidate;
+
+static int compare_candidates(const void *a, const void *b) {
+   const Candidate *x = a, *y = b;
+   if (x->heuristic != y->heuristic)
+      return (x->heuristic < y->heuristic) ? -1 : 1;
+   return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+static int compare_indices(const void *a, const void *b) {
+   u_int x = *(const u_int *) a, y = *(const u_int *) b;
+   return (x < y) ? -1 : (x > y);
+}
+
+int beam_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   Beam *beam = search->beam;
+   StateKey key = { search, cursor, cells };
+   
+   if ((get_duplicate(search, hash, cursor, cells) != NO_STATE) ||
+      (lookup_table(beam->layer, hash, &key, equal_state) != TABLE_EMPTY)) {
+      STATS_ADD(search, duplicates_closed);
+      return 0;
+   }
+   
+   uint64_t started = STATS_START(search);
+   u_int heuristic_score = child_heuristic(search, parent_id, boxes, cursor_pos);
+   STATS_STOP(search, heuristic_ticks, started);
+   if (heuristic_score == HEURISTIC_DEAD)
+      return 0;
+   
+   u_int new_id = alloc_arena(search->arena);
+   if (new_id == ARENA_NULL)
+      return 1;
+   u_int index = new_id - beam->layer_end;
+   if (index >= beam->hashes_capacity) {
+      u_int new_capacity = beam->hashes_capacity * 2;
+      uint64_t *temp = realloc(beam->hashes, sizeof(uint64_t) * new_capacity);
+      if (temp == NULL)
+         return 1;
+      beam->hashes = temp;
+      beam->hashes_capacity = new_capacity;
+   }
+   beam->hashes[index] = hash;
+   
+   State *new_state = get_state(search, new_id);
+   new_state->parent = parent_id;
+   new_state->move_from_parent = move;
+   new_state->current_pos = cursor;
+   memcpy(new_state->boxes, cells, sizeof(u_short) * search->level->num_boxes);
+   new_state->cost_score = cost;
+   new_state->heuristic_score = heuristic_score;
+   
+   if ((heuristic_score == 0) && (beam->solution == NO_STATE))
+      beam->solution = new_id;
+   return insert_table(beam->layer, hash, new_id);
+}
+
+// keeps the width children of lowest heuristic as the next depth, moved down to the front in order
+static int next_layer(Search *search) {
+   Beam *beam = search->beam;
+   Arena *arena = search->arena;
+   u_int first = beam->layer_end;
+   u_int num_children = arena->length - first;
+   u_int num_kept = num_children;
+   u_int *kept = malloc(sizeof(u_int) * (num_children + 1));
+   if (kept == NULL)
+      return 1;
+   
+   for (u_int i = 0; i < num_children; i++)
+      kept[i] = i;
+   if (num_children > beam->width) {
+      Candidate *candidates = malloc(sizeof(Candidate) * num_children);
+      if (candidates == NULL) {
+         free(kept);
+         return 1;
+      }
+      for (u_int i = 0; i < num_children; i++) {
+         candidates[i].heuristic = get_state(search, first + i)->heuristic_score;
+         candidates[i].index = i;
+      }
+      qsort(candidates, num_children, sizeof(Candidate), compare_candidates);
+      num_kept = beam->width;
+      for (u_int i = 0; i < num_kept; i++)
+         kept[i] = candidates[i].index;
+      qsort(kept, num_kept, sizeof(u_int), compare_indices);
+      free(candidates);
+      beam->pruned = True;
+   }
+   
+   // the kept children only move towards the front, so none is overwritten before it is moved
+   for (u_int i = 0; i < num_kept; i++) {
+      if (kept[i] != i) {
+         memcpy(get_state(search, first + i), get_state(search, first + kept[i]), arena->stride);
+         beam->hashes[i] = beam->hashes[kept[i]];
+      }
+   }
+   free(kept);
+   truncate_arena(arena, first + num_kept);
+   
+   for (u_int i = 0; i < num_kept; i++)
+      if (insert_table(search->table, beam->hashes[i], first + i))
+         return 1;
+   
+   free_table(beam->layer);
+   beam->layer_start = first;
+   beam->layer_end = first + num_kept;
+   beam->depth++;
+   return init_table(&beam->layer, 1024);
+}
+
+// one beam of the current width from the root, returns 1 if out of memory
+static u_int run_beam(Search *search, u_int root_id, uint64_t root_hash) {
+   Beam *beam = search->beam;
+   
+   truncate_arena(search->arena, root_id + 1);
+   free_table(search->table);
+   free_table(beam->layer);
+   if (init_table(&search->table, 1024) || insert_table(search->table, root_hash, root_id) ||
+      init_table(&beam->layer, 1024))
+      return 1;
+   beam->layer_start = root_id;
+   beam->layer_end = root_id + 1;
+   beam->depth = 0;
+   beam->pruned = False;
+   
+   while (beam->layer_start < beam->layer_end) {
+      for (u_int state_id = beam->layer_start; state_id < beam->layer_end; state_id++) {
+         if ((search->nodes % LIMIT_CHECK_INTERVAL == 0) && over_limits(search))
+            return 0;
+         if (search->expand_func(search, state_id))
+            return 1;
+         search->nodes++;
+         if (beam->solution != NO_STATE)
+            return 0;
+      }
+      if (next_layer(search))
+         return 1;
+   }
+   return 0;
+}
+
+u_int beam_search(Search *search, u_int root_id, uint64_t root_hash, u_int width) {
+   Beam beam;
+   memset(&beam, 0, sizeof(Beam));
+   beam.width = width;
+   beam.solution = NO_STATE;
+   beam.hashes_capacity = 1024;
+   if ((NULL == (beam.hashes = malloc(sizeof(uint64_t) * beam.hashes_capacity))) ||
+      init_table(&beam.layer, 1024)) {
+      free(beam.hashes);
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+      return NO_STATE;
+   }
+   search->beam = &beam;
+   search->nodes = 1;
+   if (get_state(search, root_id)->heuristic_score == 0)
+      beam.solution = root_id;
+   
+   while (beam.solution == NO_STATE) {
+      if (run_beam(search, root_id, root_hash)) {
+         search->stopped = SEARCH_OUT_OF_MEMORY;
+         break;
+      }
+      if ((beam.solution != NO_STATE) || (search->stopped != SEARCH_RUNNING) || !beam.pruned)
+         break;
+      if (!search->quiet)
+         printf("beam of width %u failed at depth %u after %lu nodes\n", beam.width,
+                beam.depth, search->nodes);
+      if (beam.width > UINT_MAX / BEAM_WIDEN_FACTOR)
+         break;
+      beam.width *= BEAM_WIDEN_FACTOR;
+   }
+   if ((beam.solution != NO_STATE) && !search->quiet)
+      printf("Found after %lu nodes with a beam of width %u\n", search->nodes, beam.width);
+   
+   search->beam = NULL;
+   free_table(beam.layer);
+   free(beam.hashes);
+   return beam.solution;
+}
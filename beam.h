@@ -0,0 +1,29 @@
+#ifndef BEAM_H
+#define BEAM_H
+
+#include <stdint.h>
+#include "sokoban.h"
+
+#define BEAM_WIDEN_FACTOR 4  // the width is multiplied by this after a beam runs out of states
+
+// greedy beam search: the states of a depth are expanded all at once and only the width children
+// with the lowest heuristic are kept for the next depth. the arena holds the kept states of every
+// depth, followed by the children of the depth being expanded
+typedef struct beam {
+   u_int width;
+   u_int layer_start;      // the states of the depth being expanded are [layer_start, layer_end)
+   u_int layer_end;
+   u_int depth;            // of the states being expanded
+   Table *layer;           // the children made so far at this depth, for duplicate detection
+   uint64_t *hashes;       // hash of every child at this depth, by id - layer_end
+   u_int hashes_capacity;
+   u_int solution;         // first child found with every box on a goal position, NO_STATE until then
+   _Bool pruned;           // children were dropped for lack of width, so a wider beam may do better
+} Beam;
+
+// searches from the root state root_id, the only state in the arena of search, with beams of the
+// given width and wider ones until a solution is found or no child was ever dropped.
+// returns the id of the solution or NO_STATE
+u_int beam_search(Search *search, u_int root_id, uint64_t root_hash, u_int width);
+
+#endif
@@ -0,0 +1,89 @@
+#!/bin/sh
+#
+# bench.sh: solves every puzzle of puzzles/ with every heuristic and writes one tab separated line per run
+#
+#    puzzle  heuristic  status  length  expected  milliseconds  nodes  nodes_per_second  peak_kb
+#
+# to BENCH_OUT. expected is the length listed in bench_lengths.txt, checked for the optimal heuristics.
+# If BENCH_BASELINE exists, every run is compared with the same run in it, and the ones that got slower,
+# expanded more nodes or took more memory by more than BENCH_THRESHOLD percent are reported.
+# Exits with 1 when a length is wrong or a run regressed. Save a baseline with "make bench-baseline".
+
+PROG=${PROG:-./sokoban}
+PUZZLES=${PUZZLES:-puzzles}
+LENGTHS=${LENGTHS:-bench_lengths.txt}
+BENCH_OUT=${BENCH_OUT:-bench.tsv}
+BENCH_BASELINE=${BENCH_BASELINE:-bench_baseline.tsv}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}    # percent
+BENCH_MIN_MS=${BENCH_MIN_MS:-50}          # faster runs are too noisy to compare their time
+BENCH_MIN_KB=${BENCH_MIN_KB:-1024}        # smaller growths of the peak memory are noise
+BENCH_TIME_LIMIT=${BENCH_TIME_LIMIT:-10}  # seconds per run
+BENCH_ARGS=${BENCH_ARGS:-}                # extra options, lengths are only checked without any
+HEURISTICS=${HEURISTICS:-"count_boxes fixed_penalty coarse_match match_closest min_matching"}
+OPTIMAL="count_boxes fixed_penalty match_closest min_matching"
+
+TMP=${TMPDIR:-/tmp}/bench.$$
+trap 'rm -f "$TMP"' EXIT
+
+printf "puzzle\theuristic\tstatus\tlength\texpected\tmilliseconds\tnodes\tnodes_per_second\tpeak_kb\n" > "$BENCH_OUT"
+failed=0
+
+for file in "$PUZZLES"/*.txt; do
+   name=$(basename "$file")
+   expected=$(awk -v name="$name" '$1 == name { print $2 }' "$LENGTHS")
+   [ -n "$expected" ] || expected=-
+   for heuristic in $HEURISTICS; do
+      # a batch of one puzzle gives its nodes, time and status in one line and the peak memory after it
+      $PROG --batch="$file" --time-limit="$BENCH_TIME_LIMIT" $BENCH_ARGS $heuristic > "$TMP" 2> "$TMP.err"
+      peak=$(sed -n 's/.*peak memory \([0-9]*\) kB.*/\1/p' "$TMP.err")
+      rm -f "$TMP.err"
+      # not a puzzle, like the results file: no result line or an invalid one
+      [ -s "$TMP" ] || continue 2
+      grep -q "	invalid	" "$TMP" && continue 2
+      line=$(awk -F '\t' -v name="$name" -v heuristic="$heuristic" -v expected="$expected" -v peak="${peak:-0}" '
+         NR == 1 {
+            nps = ($5 > 0) ? int($4 * 1000 / $5) : 0
+            printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n", name, heuristic, $2, $3, expected, $5, $4, nps, peak
+         }' "$TMP")
+      printf "%s\n" "$line" >> "$BENCH_OUT"
+      status=$(printf "%s" "$line" | cut -f 3)
+      length=$(printf "%s" "$line" | cut -f 4)
+      printf "%-24s %-14s %-9s %5s moves %8s ms\n" "$name" "$heuristic" "$status" "$length" \
+             "$(printf "%s" "$line" | cut -f 6)"
+      case " $OPTIMAL " in
+         *" $heuristic "*)
+            if [ -z "$BENCH_ARGS" ] && [ "$status" = solved ] && [ "$expected" != - ] && [ "$length" != "$expected" ]; then
+               echo "WRONG LENGTH: $name with $heuristic took $length moves instead of $expected"
+               failed=1
+            fi;;
+      esac
+   done
+done
+
+if [ -f "$BENCH_BASELINE" ]; then
+   awk -F '\t' -v threshold="$BENCH_THRESHOLD" -v min_ms="$BENCH_MIN_MS" -v min_kb="$BENCH_MIN_KB" '
+      function worse(now, before) { return before > 0 && now > before * (1 + threshold / 100) }
+      FNR == 1 { next }
+      NR == FNR { key = $1 "\t" $2; status[key] = $3; ms[key] = $6; nodes[key] = $7; peak[key] = $9; next }
+      {
+         key = $1 "\t" $2
+         if (!(key in status))
+            next
+         if (status[key] == "solved" && $3 != "solved")
+            { printf "REGRESSION %s %s: %s, was solved\n", $1, $2, $3; regressed = 1 }
+         else if ($3 == "solved" && status[key] == "solved") {
+            if (ms[key] >= min_ms && worse($6, ms[key]))
+               { printf "REGRESSION %s %s: %d ms, was %d ms\n", $1, $2, $6, ms[key]; regressed = 1 }
+            if (worse($7, nodes[key]))
+               { printf "REGRESSION %s %s: %d nodes, was %d\n", $1, $2, $7, nodes[key]; regressed = 1 }
+            if (worse($9, peak[key]) && $9 - peak[key] > min_kb)
+               { printf "REGRESSION %s %s: %d kB, was %d kB\n", $1, $2, $9, peak[key]; regressed = 1 }
+         }
+      }
+      END { exit regressed }' "$BENCH_BASELINE" "$BENCH_OUT" || failed=1
+else
+   echo "no baseline $BENCH_BASELINE to compare with"
+fi
+
+echo "results in $BENCH_OUT"
+exit $failed
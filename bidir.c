@@ -0,0 +1,196 @@
+/*
+ * bidir.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bidirectional search: the forward search is the usual push mode search. The backward search
+ * starts from every box on a goal position, once per region the cursor can be in, and pulls
+ * boxes instead of pushing them, expanding the states with the fewest pulls first. Both use
+ * the same zobrist keys and normalized cursors, so a state stored by one can be looked up in
+ * the state table of the other, and the search ends at the first state stored by both.
+ * Whichever side has the smaller frontier is expanded next.
+ * The path is the forward one up to the meeting state followed by the backward one read
+ * from there to its root, each pull undone as a push. Meeting first does not make it the
+ * cheapest path, so solutions are not push optimal in this mode.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bidir.h"
+#include "deadlock.h"
+#include "push.h"
+
+// the backward search has no estimate of the pulls left
+static u_int heuristic_none(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   return 0;
+}
+
+int meet_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   Bidir *bidir = search->bidir;
+   
+   if (insert_child(search, parent_id, 0, cost, move, hash, cursor, cells, cursor_pos, boxes))
+      return 1;
+   if (bidir->meet_forward != NO_STATE)
+      return 0;
+   
+   Search *other = (search == bidir->forward) ? bidir->backward : bidir->forward;
+   u_int other_id = get_duplicate(other, hash, cursor, cells);
+   if (other_id == NO_STATE)
+      return 0;
+   u_int own_id = get_duplicate(search, hash, cursor, cells);
+   if (own_id == NO_STATE)
+      return 0;   // dropped as a deadlock by the forward search
+   
+   bidir->meet_forward = (search == bidir->forward) ? own_id : other_id;
+   bidir->meet_backward = (search == bidir->forward) ? other_id : own_id;
+   return 0;
+}
+
+static int init_backward(Search *backward, Search *forward) {
+   Level *level = forward->level;
+   
+   memset(backward, 0, sizeof(Search));
+   backward->level = level;
+   backward->verbose = False;
+   backward->stats.enabled = forward->stats.enabled;
+   backward->expand_func = make_pull;
+   backward->start = forward->start;
+   backward->zobrist = forward->zobrist;
+   backward->bidir = forward->bidir;
+   
+   if (init_heuristic(backward, heuristic_none) ||
+      init_arena(&backward->arena, forward->arena->stride) ||
+      init_table(&backward->table, 1024) ||
+      init_pqueue(&backward->states, forward->states->kind, forward->states->tie_break) ||
+      init_deadlock(backward) ||
+      init_push(backward))
+      return 1;
+   
+   // every box on a goal position, with the cursor in each region it can be left in by the last push
+   u_int num_boxes = level->num_boxes;
+   u_short cells[num_boxes];
+   u_short regions[4 * num_boxes];
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      cells[i] = level_cell(level, &level->goal_positions[i]);
+   u_int num_regions = cursor_regions(backward, cells, regions);
+   
+   uint64_t hash = 0;
+   for (u_int i = 0; i < num_boxes; i++)
+      hash ^= backward->zobrist.boxes[cells[i]];
+   
+   for (u_int i = 0; i < num_regions; i++)
+      if (meet_child(backward, NO_STATE, 0, 0, hash ^ backward->zobrist.cursor[regions[i]], regions[i],
+                     cells, NULL, level->goal_positions))
+         return 1;
+   return 0;
+}
+
+static void free_backward(Search *backward) {
+   if (backward->arena != NULL)
+      free_arena(backward->arena);
+   if (backward->table != NULL)
+      free_table(backward->table);
+   if (backward->states != NULL)
+      free_pqueue(backward->states);
+   free_deadlock(backward);
+   free_push(backward);
+}
+
+// appends the backward path from the meeting state to its root behind the forward one, as pushes
+static u_int join_paths(Bidir *bidir) {
+   Search *forward = bidir->forward;
+   u_int id = bidir->meet_forward;
+   State *state = get_state(bidir->backward, bidir->meet_backward);
+   
+   while (state->parent != NO_STATE) {
+      State *parent = get_state(bidir->backward, state->parent);
+      u_int copy_id = alloc_arena(forward->arena);
+      if (copy_id == ARENA_NULL)
+         return NO_STATE;
+      
+      State *copy = get_state(forward, copy_id);
+      memcpy(copy, parent, forward->arena->stride);
+      copy->parent = id;
+      copy->move_from_parent = state->move_from_parent;
+      copy->cost_score = get_state(forward, id)->cost_score + 1;
+      
+      id = copy_id;
+      state = parent;
+   }
+   return id;
+}
+
+u_int bidir_search(Search *forward, u_int root_id, uint64_t root_hash) {
+   Bidir bidir = { forward, NULL, NO_STATE, NO_STATE };
+   Search backward;
+   
+   bidir.backward = &backward;
+   forward->bidir = &bidir;
+   if (init_backward(&backward, forward)) {
+      forward->stopped = SEARCH_OUT_OF_MEMORY;
+      forward->bidir = NULL;
+      free_backward(&backward);
+      return NO_STATE;
+   }
+   
+   // the start may be solved already
+   State *root = get_state(forward, root_id);
+   u_int solved = get_duplicate(&backward, root_hash, root->current_pos, root->boxes);
+   if (solved != NO_STATE) {
+      bidir.meet_forward = root_id;
+      bidir.meet_backward = solved;
+   }
+   
+   unsigned long nodes = 1, backward_nodes = 0;
+   while ((bidir.meet_forward == NO_STATE) && (forward->states->length > 0) && (backward.states->length > 0)) {
+      Search *side = (forward->states->length <= backward.states->length) ? forward : &backward;
+      u_int state_id = remove_min_pqueue(side->states);
+      
+      if (forward->verbose && (side == forward)) {
+         printf("\n#########################\nExpanding State: \n");
+         print_state(forward, get_state(forward, state_id));
+      }
+      if (side->expand_func(side, state_id)) {
+         forward->stopped = SEARCH_OUT_OF_MEMORY;
+         break;
+      }
+      
+      nodes++;
+      if (side == &backward)
+         backward_nodes++;
+      // the memory limit is checked against the containers of the forward search only
+      if ((nodes % LIMIT_CHECK_INTERVAL == 0) && over_limits(forward))
+         break;
+   }
+   forward->nodes = nodes;
+   
+   u_int solution = NO_STATE;
+   if ((bidir.meet_forward != NO_STATE) && (forward->stopped == SEARCH_RUNNING)) {
+      if (!forward->quiet) {
+         printf("Found after %lu nodes\n", nodes);
+         printf("backward search: %lu nodes, %u states\n", backward_nodes, backward.arena->length);
+      }
+      if (NO_STATE == (solution = join_paths(&bidir)))
+         forward->stopped = SEARCH_OUT_OF_MEMORY;
+   }
+   
+   merge_stats(&forward->stats, &backward.stats);
+   forward->bidir = NULL;
+   free_backward(&backward);
+   return solution;
+}
@@ -0,0 +1,19 @@
+#ifndef BIDIR_H
+#define BIDIR_H
+
+#include "sokoban.h"
+
+// a forward push search from the start and a backward pull search from the solved configurations,
+// each with its own states, looking up every state they store in the state table of the other
+typedef struct bidir {
+   Search *forward;
+   Search *backward;
+   u_int meet_forward;     // the state both searches reached, NO_STATE until then
+   u_int meet_backward;
+} Bidir;
+
+// searches from the root state root_id of the push mode search forward, whose hash is root_hash.
+// the backward half of the solution is copied into the arena of forward, returns the solution or NO_STATE
+u_int bidir_search(Search *forward, u_int root_id, uint64_t root_hash);
+
+#endif
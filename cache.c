@@ -0,0 +1,300 @@
+/*
+ * cache.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Solution cache. Optimal solutions are appended to a file, which is mapped in memory to look a puzzle
+ * up, so a puzzle solved before is answered without building its tables or searching.
+ * 
+ * A puzzle is looked up by the hash of its canonical form: the cells the cursor can walk to when the
+ * boxes are ignored, with their goal positions and boxes, inside the smallest rectangle holding them
+ * plus a border of walls. Everything the cursor can't get to is a wall, so the same puzzle drawn with
+ * other decoration outside of its walls, other padding or at another place in the file has the same
+ * key. The cursor cell itself is part of the key, as the stored moves start from it.
+ * 
+ * Records are only ever appended. A record of another version is stale and skipped, and one whose
+ * checksum doesn't match is corrupt and skipped. A record cut short, or garbage, is skipped 8 bytes at
+ * a time until the next record magic. The moves of a matching record are replayed on the puzzle before
+ * they are returned, which also rules out the rare key collision.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // mmap, fstat, open
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_CHECK_OFFSET 0x84222325cbf29ce4ULL  // seed of the second hash of the canonical level
+#define FNV_PRIME 0x100000001b3ULL
+#define CACHE_ALIGN 8
+
+// FNV-1a
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t length) {
+   const u_char *bytes = data;
+   for (size_t i = 0; i < length; i++) {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+   }
+   return hash;
+}
+
+static size_t padded_length(size_t length) {
+   return (length + CACHE_ALIGN - 1) & ~(size_t) (CACHE_ALIGN - 1);
+}
+
+static _Bool grid_wall(Level *level, u_int cell) {
+   return (level->grid[cell] == '#') || (level->grid[cell] == GRID_OUTSIDE);
+}
+
+// hashes the canonical form of the puzzle into key and check, returns 1 if out of memory
+static int canonical_key(Level *level, Coordinate start, Coordinate *boxes, uint64_t *key, uint64_t *check) {
+   u_int num_cells = level->height * level->width;
+   u_char *region = calloc(num_cells, sizeof(u_char));
+   u_short *queue = malloc(sizeof(u_short) * num_cells);
+   if ((region == NULL) || (queue == NULL)) {
+      free(region);
+      free(queue);
+      return 1;
+   }
+   
+   // the cells the cursor can walk to without the boxes, and the rectangle holding them
+   u_int head = 0, tail = 0;
+   u_int min_x = start.x, max_x = start.x, min_y = start.y, max_y = start.y;
+   queue[tail++] = level_cell(level, &start);
+   region[queue[0]] = 1;
+   while (head < tail) {
+      u_short cell = queue[head++];
+      u_int x = cell / level->width, y = cell % level->width;
+      if (x < min_x) min_x = x;
+      if (x > max_x) max_x = x;
+      if (y < min_y) min_y = y;
+      if (y > max_y) max_y = y;
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + level->offsets[mv];
+         if (!grid_wall(level, next) && !region[next]) {
+            region[next] = 1;
+            queue[tail++] = next;
+         }
+      }
+   }
+   for (u_int i = 0; i < level->num_boxes; i++) {
+      Coordinate *pos[2] = { &boxes[i], &level->goal_positions[i] };
+      for (int j = 0; j < 2; j++) {
+         if ((u_int) pos[j]->x < min_x) min_x = pos[j]->x;
+         if ((u_int) pos[j]->x > max_x) max_x = pos[j]->x;
+         if ((u_int) pos[j]->y < min_y) min_y = pos[j]->y;
+         if ((u_int) pos[j]->y > max_y) max_y = pos[j]->y;
+      }
+   }
+   
+   // the rectangle with a border of walls, the padding of the grid keeps the border inside of it
+   min_x--, min_y--, max_x++, max_y++;
+   u_int rows = max_x - min_x + 1, columns = max_y - min_y + 1;
+   char *canonical = (char *) queue;   // the queue is done with, and holds as many bytes
+   for (u_int x = 0; x < rows; x++) {
+      for (u_int y = 0; y < columns; y++) {
+         u_int cell = (min_x + x) * level->width + min_y + y;
+         canonical[x * columns + y] = (level->grid[cell] == '.') ? '.' : (region[cell] ? ' ' : '#');
+      }
+   }
+   for (u_int i = 0; i < level->num_boxes; i++) {
+      char *cell = &canonical[(boxes[i].x - min_x) * columns + boxes[i].y - min_y];
+      *cell = (*cell == '.') ? '*' : '$';
+   }
+   
+   uint32_t header[3] = { rows, columns, (start.x - min_x) * columns + start.y - min_y };
+   *key = hash_bytes(hash_bytes(FNV_OFFSET, header, sizeof(header)), canonical, rows * columns);
+   *check = hash_bytes(hash_bytes(FNV_CHECK_OFFSET, header, sizeof(header)), canonical, rows * columns);
+   free(region);
+   free(queue);
+   return 0;
+}
+
+/*
+ * plays moves from the start of the puzzle. returns the number of moves, or of pushes in push mode,
+ * if every move can be made and the boxes end on the goal positions, UINT_MAX otherwise
+ */
+static u_int replay(Level *level, Coordinate start, Coordinate *boxes, const char *moves, size_t length, _Bool push_mode) {
+   u_int num_cells = level->height * level->width;
+   u_char *box = calloc(num_cells, sizeof(u_char));
+   if (box == NULL)
+      return UINT_MAX;
+   for (u_int i = 0; i < level->num_boxes; i++)
+      box[level_cell(level, &boxes[i])] = 1;
+   
+   u_short cursor = level_cell(level, &start);
+   u_int num_moves = 0, num_pushes = 0;
+   _Bool valid = True;
+   size_t pos = 0;
+   while (valid && (pos < length)) {
+      size_t end = pos;
+      while ((end < length) && (moves[end] != ' '))
+         end++;
+      
+      int move = -1;
+      for (int mv = 0; mv < 4; mv++)
+         if ((strlen(move_name(mv)) == end - pos) && (strncmp(move_name(mv), moves + pos, end - pos) == 0))
+            move = mv;
+      pos = end + 1;
+      if (move < 0) {
+         valid = False;
+         break;
+      }
+      
+      u_short next = cursor + level->offsets[move];
+      u_short beyond = next + level->offsets[move];
+      if (grid_wall(level, next) || (box[next] && (grid_wall(level, beyond) || box[beyond]))) {
+         valid = False;
+         break;
+      }
+      if (box[next]) {
+         box[next] = 0;
+         box[beyond] = 1;
+         num_pushes++;
+      }
+      cursor = next;
+      num_moves++;
+   }
+   
+   for (u_int i = 0; valid && (i < num_cells); i++)
+      if (box[i] && (level->grid[i] != '.'))
+         valid = False;
+   free(box);
+   if (!valid)
+      return UINT_MAX;
+   return push_mode ? num_pushes : num_moves;
+}
+
+static uint64_t record_checksum(const CacheRecord *record, const char *moves) {
+   CacheRecord copy = *record;
+   copy.checksum = 0;
+   return hash_bytes(hash_bytes(FNV_OFFSET, &copy, sizeof(CacheRecord)), moves, record->length);
+}
+
+int find_cached(const char *path, Level *level, Coordinate start, Coordinate *boxes, _Bool push_mode, CacheHit *hit) {
+   struct stat info;
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return 0;
+   if ((fstat(fd, &info) != 0) || (info.st_size < (off_t) sizeof(CacheRecord))) {
+      close(fd);
+      return 0;
+   }
+   size_t size = info.st_size;
+   const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED)
+      return 0;
+   
+   uint64_t key, check;
+   if (canonical_key(level, start, boxes, &key, &check)) {
+      munmap((void *) data, size);
+      return 0;
+   }
+   
+   const CacheRecord *found = NULL;
+   size_t pos = 0;
+   while (pos + sizeof(CacheRecord) <= size) {
+      const CacheRecord *record = (const CacheRecord *) (data + pos);
+      size_t next = pos + sizeof(CacheRecord) + padded_length(record->length);
+      
+      // a record cut short has later ones appended over its end, its length is only trusted if the
+      // next record or the end of the file is where it says
+      if ((record->magic != CACHE_RECORD_MAGIC) || (record->length > size - pos - sizeof(CacheRecord)) ||
+         ((next + sizeof(uint32_t) <= size) && (((const CacheRecord *) (data + next))->magic != CACHE_RECORD_MAGIC))) {
+         pos += CACHE_ALIGN;
+         continue;
+      }
+      
+      const char *moves = data + pos + sizeof(CacheRecord);
+      if ((record->version == CACHE_VERSION) && (record->key == key) && (record->check == check) &&
+         (record->push_mode == push_mode)) {
+         if (record->checksum != record_checksum(record, moves)) {
+            pos += CACHE_ALIGN;
+            continue;
+         }
+         if (replay(level, start, boxes, moves, record->length, push_mode) == record->cost)
+            found = record;
+      }
+      pos = next;
+   }
+   
+   if (found != NULL) {
+      hit->moves = malloc(found->length + 1);
+      if (hit->moves == NULL)
+         found = NULL;
+      else {
+         memcpy(hit->moves, (const char *) (found + 1), found->length);
+         hit->moves[found->length] = 0;
+         hit->cost = found->cost;
+         memcpy(hit->heuristic, found->heuristic, CACHE_NAME_SIZE - 1);
+         hit->heuristic[CACHE_NAME_SIZE - 1] = 0;
+         memcpy(hit->mode, found->mode, CACHE_NAME_SIZE);
+         hit->mode[CACHE_NAME_SIZE - 1] = 0;
+      }
+   }
+   munmap((void *) data, size);
+   return found != NULL;
+}
+
+int store_cached(const char *path, Level *level, Coordinate start, Coordinate *boxes, _Bool push_mode,
+                 const char *moves, const char *heuristic, const char *mode) {
+   size_t length = strlen(moves);
+   u_int cost = replay(level, start, boxes, moves, length, push_mode);
+   if (cost == UINT_MAX)
+      return 1;
+   
+   size_t size = sizeof(CacheRecord) + padded_length(length);
+   char *buffer = calloc(size, 1);
+   if (buffer == NULL)
+      return 1;
+   CacheRecord *record = (CacheRecord *) buffer;
+   record->magic = CACHE_RECORD_MAGIC;
+   record->version = CACHE_VERSION;
+   record->cost = cost;
+   record->length = length;
+   record->push_mode = push_mode;
+   strncpy(record->heuristic, heuristic, CACHE_NAME_SIZE - 2);
+   strncpy(record->mode, mode, CACHE_NAME_SIZE - 1);
+   memcpy(buffer + sizeof(CacheRecord), moves, length);
+   if (canonical_key(level, start, boxes, &record->key, &record->check)) {
+      free(buffer);
+      return 1;
+   }
+   record->checksum = record_checksum(record, moves);
+   
+   int failed = 1;
+   int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+   if (fd >= 0) {
+      // a record cut short by an earlier crash would leave the new one off the 8 byte grid
+      struct stat info;
+      char zeros[CACHE_ALIGN] = { 0 };
+      failed = (fstat(fd, &info) != 0);
+      if (!failed && (info.st_size % CACHE_ALIGN != 0))
+         failed = (write(fd, zeros, CACHE_ALIGN - info.st_size % CACHE_ALIGN) < 0);
+      if (!failed)
+         failed = (write(fd, buffer, size) != (ssize_t) size);
+      failed |= (close(fd) != 0);
+   }
+   free(buffer);
+   return failed;
+}
@@ -0,0 +1,48 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include "sokoban.h"
+
+#define CACHE_RECORD_MAGIC 0x534F4B43U  // "SOKC"
+#define CACHE_VERSION 1                 // records of other versions are stale and skipped
+#define CACHE_NAME_SIZE 16
+
+/*
+ * one solution of the cache file, followed by its moves padded to a multiple of 8 bytes.
+ * the key is the hash of the canonical level (see cache.c), with a second hash of it under another
+ * seed as a check, and the checksum covers the record, with the checksum itself zeroed, and the moves
+ */
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t key;
+   uint64_t check;
+   uint64_t checksum;
+   uint32_t cost;          // moves, or pushes for a push optimal solution
+   uint32_t length;        // bytes of the moves, without the padding
+   u_char push_mode;
+   char heuristic[CACHE_NAME_SIZE - 1];
+   char mode[CACHE_NAME_SIZE];   // the search that found the solution
+} CacheRecord;
+
+// a solution found in the cache
+typedef struct {
+   char *moves;            // freed by the caller
+   u_int cost;
+   char heuristic[CACHE_NAME_SIZE];
+   char mode[CACHE_NAME_SIZE];
+} CacheHit;
+
+/*
+ * looks the puzzle up in the cache file path, for a move optimal solution or a push optimal one in
+ * push mode. returns 1 and fills hit if a valid solution is stored, 0 if there is none or no file.
+ * the last stored solution that passes its checksum and solves the puzzle when replayed is used
+ */
+int find_cached(const char *path, Level *level, Coordinate start, Coordinate *boxes, _Bool push_mode, CacheHit *hit);
+
+// appends the optimal solution moves of the puzzle to the cache file path, returns 1 if it can't be written
+int store_cached(const char *path, Level *level, Coordinate start, Coordinate *boxes, _Bool push_mode,
+                 const char *moves, const char *heuristic, const char *mode);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * corral.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * PI-corral pruning for the push mode. A corral is an area of floor the cursor can't walk to, fenced
+ * in by walls and boxes. If a box next to it is off its goal position or a goal position in it is
+ * empty, some push of a box next to it is part of every solution. When those boxes can only be pushed
+ * into the area (I) and the cursor can already get behind them for every such push (P), the first of
+ * those pushes can be made right away: no push of the other boxes can make it possible nor be blocked
+ * by it, so moving it to the front of a solution keeps the number of pushes. Only the pushes of one
+ * PI-corral are then made, and the solutions stay push optimal.
+ * 
+ * The other boxes are taken as gone when looking at where the boxes next to the area could be pushed,
+ * since they may have been moved by the time of the first push. A PI-corral without any push is a
+ * deadlock and leaves no child at all.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "corral.h"
+
+int init_corral(Search *search) {
+   u_int num_cells = search->level->num_cells;
+   u_int num_boxes = search->level->num_boxes;
+   Corral *corral = calloc(1, sizeof(Corral));
+   search->corral = corral;
+   if (corral == NULL)
+      return 1;
+   
+   corral->area = calloc(num_cells, sizeof(u_int));
+   corral->queue = malloc(sizeof(u_short) * num_cells);
+   corral->member = malloc(sizeof(u_char) * (num_boxes + 1));
+   corral->candidate = malloc(sizeof(u_char) * (num_boxes + 1));
+   corral->pushes = malloc(sizeof(u_char) * (num_boxes + 1));
+   if ((corral->area == NULL) || (corral->queue == NULL) || (corral->member == NULL) ||
+      (corral->candidate == NULL) || (corral->pushes == NULL))
+      return 1;
+   return 0;
+}
+
+void free_corral(Search *search) {
+   Corral *corral = search->corral;
+   if (corral == NULL)
+      return;
+   free(corral->area);
+   free(corral->queue);
+   free(corral->member);
+   free(corral->candidate);
+   free(corral->pushes);
+   free(corral);
+   search->corral = NULL;
+}
+
+// marks with stamp the area the cursor can't walk to around start, returns whether it holds a goal position
+static _Bool flood_area(Search *search, u_short start, u_int reach_stamp, u_int stamp) {
+   Level *level = search->level;
+   u_int *area = search->corral->area;
+   u_short *queue = search->corral->queue;
+   u_int head = 0, tail = 0;
+   _Bool has_goal = False;
+   
+   queue[tail++] = start;
+   area[start] = stamp;
+   while (head < tail) {
+      u_short cell = queue[head++];
+      has_goal |= (level->grid[cell] == '.');
+      
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + level->offsets[mv];
+         if (level->walls[next] || search->box_map[next] || (search->reach[next] == reach_stamp) ||
+            (area[next] == stamp))
+            continue;
+         area[next] = stamp;
+         queue[tail++] = next;
+      }
+   }
+   return has_goal;
+}
+
+/*
+ * sets candidate to the pushes of the boxes next to the area marked stamp and returns their number,
+ * or -1 if the area is not a PI-corral
+ */
+static int corral_pushes(Search *search, u_short *cells, u_int reach_stamp, u_int stamp, _Bool has_goal) {
+   Level *level = search->level;
+   Corral *corral = search->corral;
+   u_int num_boxes = level->num_boxes;
+   u_int *area = corral->area;
+   
+   for (u_int i = 0; i < num_boxes; i++) {
+      corral->member[i] = 0;
+      corral->candidate[i] = 0;
+      for (int mv = 0; mv < 4; mv++)
+         if (area[cells[i] + level->offsets[mv]] == stamp)
+            corral->member[i] = 1;
+   }
+   
+   _Bool needs_push = has_goal;
+   int num_pushes = 0;
+   for (u_int i = 0; i < num_boxes; i++) {
+      if (!corral->member[i])
+         continue;
+      needs_push |= (level->grid[cells[i]] != '.');
+      
+      for (int mv = 0; mv < 4; mv++) {
+         u_short from = cells[i] - level->offsets[mv];
+         u_short to = cells[i] + level->offsets[mv];
+         
+         // the cursor can't get behind the box before a box of the corral is pushed
+         if (level->walls[from] || (area[from] == stamp) ||
+            (search->box_map[from] && corral->member[search->box_map[from] - 1]))
+            continue;
+         // nor can the push ever be made
+         if (level->walls[to] || level->dead[to] || (search->box_map[to] && corral->member[search->box_map[to] - 1]))
+            continue;
+         
+         if ((area[to] != stamp) || (search->reach[from] != reach_stamp))
+            return -1;
+         corral->candidate[i] |= 1 << mv;
+         num_pushes++;
+      }
+   }
+   return needs_push ? num_pushes : -1;
+}
+
+_Bool find_pi_corral(Search *search, u_short *cells, u_int reach_stamp) {
+   Level *level = search->level;
+   Corral *corral = search->corral;
+   u_int num_boxes = level->num_boxes;
+   
+   // a fresh stamp per area, the marks are cleared once the stamps could run out during a call
+   if (corral->stamp > UINT_MAX - level->num_cells) {
+      memset(corral->area, 0, sizeof(u_int) * level->num_cells);
+      corral->stamp = 0;
+   }
+   u_int first = corral->stamp + 1;
+   
+   int fewest = -1;
+   for (u_int i = 0; i < num_boxes; i++) {
+      for (int mv = 0; mv < 4; mv++) {
+         u_short start = cells[i] + level->offsets[mv];
+         if (level->walls[start] || search->box_map[start] || (search->reach[start] == reach_stamp) ||
+            (corral->area[start] >= first))
+            continue;
+         
+         u_int stamp = ++corral->stamp;
+         _Bool has_goal = flood_area(search, start, reach_stamp, stamp);
+         int num_pushes = corral_pushes(search, cells, reach_stamp, stamp, has_goal);
+         if ((num_pushes >= 0) && ((fewest < 0) || (num_pushes < fewest))) {
+            fewest = num_pushes;
+            memcpy(corral->pushes, corral->candidate, sizeof(u_char) * num_boxes);
+         }
+      }
+   }
+   return fewest >= 0;
+}
@@ -0,0 +1,28 @@
+#ifndef CORRAL_H
+#define CORRAL_H
+
+#include "sokoban.h"
+
+// scratch space of the corral search, indexed by cell or by box
+typedef struct corral {
+   u_int *area;            // stamp of the last corral area a cell was found in
+   u_int stamp;
+   u_short *queue;
+   u_char *member;         // member[box]: 1 for the boxes next to the corral area being checked
+   u_char *candidate;      // candidate[box]: bit mv set for each push of the corral being checked
+   u_char *pushes;         // same for the PI-corral with the fewest pushes
+   unsigned long pruned;   // pushes left out because they were not part of a PI-corral
+} Corral;
+
+int init_corral(Search *search);
+
+void free_corral(Search *search);
+
+/*
+ * looks for a PI-corral around the boxes in cells, which have to be marked in search->box_map, with the
+ * cells the cursor can walk to marked reach_stamp in search->reach. returns whether one was found, the
+ * pushes of the one with the fewest are then set in search->corral->pushes and the others can be left out
+ */
+_Bool find_pi_corral(Search *search, u_short *cells, u_int reach_stamp);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * deadlock.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Freeze deadlocks: the dead-square map of the level (see level.c) only knows about the walls,
+ * so two boxes side by side against a wall are never caught by it although neither can move again.
+ * A box is frozen when it can be pushed along neither axis. It can't be pushed along an axis if
+ * on that axis:
+ *         one of its neighbours is a wall
+ *         both of its neighbours are dead squares
+ *         one of its neighbours is a frozen box
+ * A frozen box off a goal position can never be solved. Only boxes around the box just pushed
+ * can have become frozen, so the check starts from it and follows the neighbouring boxes only.
+ */
+
+#include <stdlib.h>
+#include "deadlock.h"
+
+int init_deadlock(Search *search) {
+   u_int num_cells = search->level->num_cells;
+   
+   search->box_map = calloc(num_cells, sizeof(u_char));
+   search->chain = calloc(num_cells, sizeof(u_char));
+   search->freeze_pruned = 0;
+   
+   if ((search->box_map == NULL) || (search->chain == NULL))
+      return 1;
+   return 0;
+}
+
+void free_deadlock(Search *search) {
+   free(search->box_map);
+   free(search->chain);
+}
+
+static _Bool is_frozen(Search *search, u_short cell, _Bool *off_goal);
+
+// whether the box at cell can't be pushed along the axis given by offset
+static _Bool axis_blocked(Search *search, u_short cell, int offset, _Bool *off_goal) {
+   Level *level = search->level;
+   u_short before = cell - offset;
+   u_short after = cell + offset;
+   
+   // the boxes of the chain being checked count as walls, this also stops the recursion
+   if (level->walls[before] || level->walls[after] || search->chain[before] || search->chain[after])
+      return True;
+   if (level->dead[before] && level->dead[after])
+      return True;
+   if (search->box_map[before] && is_frozen(search, before, off_goal))
+      return True;
+   if (search->box_map[after] && is_frozen(search, after, off_goal))
+      return True;
+   return False;
+}
+
+static _Bool is_frozen(Search *search, u_short cell, _Bool *off_goal) {
+   // only a frozen box passes on what it found, a box that can still move proves nothing
+   _Bool chain_off_goal = (search->level->min_push_dist[cell] != 0); // goal positions are at distance 0
+   
+   search->chain[cell] = 1;
+   _Bool frozen = axis_blocked(search, cell, search->level->width, &chain_off_goal) &&
+                  axis_blocked(search, cell, 1, &chain_off_goal);
+   search->chain[cell] = 0;
+   
+   if (frozen && chain_off_goal)
+      *off_goal = True;
+   return frozen;
+}
+
+_Bool freeze_deadlock(Search *search, u_short *cells, u_int box_id) {
+   _Bool off_goal = False;
+   
+   if (is_frozen(search, cells[box_id], &off_goal) && off_goal) {
+      search->freeze_pruned++;
+      STATS_ADD(search, freeze_pruned);
+      return True;
+   }
+   return False;
+}
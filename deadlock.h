@@ -0,0 +1,14 @@
+#ifndef DEADLOCK_H
+#define DEADLOCK_H
+
+#include "sokoban.h"
+
+int init_deadlock(Search *search);
+
+void free_deadlock(Search *search);
+
+// whether pushing box box_id to cells[box_id] froze boxes that are not all on goal positions.
+// the boxes have to be marked in search->box_map
+_Bool freeze_deadlock(Search *search, u_short *cells, u_int box_id);
+
+#endif
@@ -0,0 +1,459 @@
+/*
+ * hda.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hash distributed A*: the threads share nothing but the level and the zobrist keys. A state is
+ * owned by the thread hash % threads, that thread alone looks it up, stores it and expands it.
+ * A child owned by another thread is appended to a batch for that thread, full batches are pushed
+ * to the inbox of the owner (a lock-free queue with many producers and one consumer).
+ * 
+ * A thread popping a goal state records it as the incumbent if it is cheaper than the current one,
+ * and states with f not below the cost of the incumbent are dropped instead of expanded. Once no
+ * thread has a state left and no batch is in flight, no cheaper solution can exist, so the
+ * incumbent is as optimal as the one the single threaded search finds.
+ * Termination: every batch is counted when pushed and again once its children are stored.
+ * A thread out of states marks itself idle and checks whether all the threads are idle with
+ * the two counters equal and unchanged before and after reading the idle marks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "hda.h"
+#include "deadlock.h"
+#include "pattern.h"
+#include "push.h"
+#include "corral.h"
+#include "macro.h"
+
+#define NO_INCUMBENT UINT64_MAX
+
+// a child in a batch, the boxes follow the fixed part
+typedef struct {
+   uint64_t hash;
+   u_int parent;
+   u_int cost;
+   u_short cursor;
+   u_char move;
+   u_char parent_thread;
+   u_short boxes[];
+} Message;
+
+#define MESSAGE_SIZE(num_boxes) ((sizeof(Message) + sizeof(u_short) * (num_boxes) + 7) & ~7U)
+
+static int init_inbox(Inbox *inbox) {
+   inbox->stub = calloc(1, sizeof(Batch));
+   if (inbox->stub == NULL)
+      return 1;
+   inbox->head = inbox->tail = inbox->stub;
+   return 0;
+}
+
+static void push_inbox(Inbox *inbox, Batch *batch) {
+   __atomic_store_n(&batch->next, NULL, __ATOMIC_RELAXED);
+   Batch *prev = __atomic_exchange_n(&inbox->head, batch, __ATOMIC_ACQ_REL);
+   // until this store the batch can't be reached from the tail, pop_inbox waits for it
+   __atomic_store_n(&prev->next, batch, __ATOMIC_RELEASE);
+}
+
+// returns NULL if the inbox is empty or the batch pushed last is not linked yet
+static Batch *pop_inbox(Inbox *inbox) {
+   Batch *tail = inbox->tail;
+   Batch *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   
+   if (tail == inbox->stub) {
+      if (next == NULL)
+         return NULL;
+      inbox->tail = tail = next;
+      next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   }
+   if (next != NULL) {
+      inbox->tail = next;
+      return tail;
+   }
+   
+   // tail is the last batch, the stub is put behind it so that it can be taken out
+   if (tail != __atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE))
+      return NULL;
+   push_inbox(inbox, inbox->stub);
+   next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   if (next != NULL) {
+      inbox->tail = next;
+      return tail;
+   }
+   return NULL;
+}
+
+static void free_inbox(Inbox *inbox) {
+   Batch *batch;
+   while ((batch = pop_inbox(inbox)) != NULL)
+      free(batch);
+   free(inbox->stub);
+}
+
+static u_int owner(Hda *hda, uint64_t hash) {
+   // the table slot is taken from the upper half of the hash, the owner from the lower one
+   return (u_int) (hash & 0xFFFFFFFF) % hda->num_threads;
+}
+
+static u_int incumbent_cost(Hda *hda) {
+   uint64_t incumbent = __atomic_load_n(&hda->incumbent, __ATOMIC_ACQUIRE);
+   return (incumbent == NO_INCUMBENT) ? UINT_MAX : (u_int) (incumbent >> 40);
+}
+
+static void improve_incumbent(Hda *hda, u_int cost, u_char thread, u_int state_id) {
+   uint64_t candidate = ((uint64_t) cost << 40) | ((uint64_t) thread << 32) | state_id;
+   uint64_t current = __atomic_load_n(&hda->incumbent, __ATOMIC_ACQUIRE);
+   
+   while (candidate < current)
+      if (__atomic_compare_exchange_n(&hda->incumbent, &current, candidate, False, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+         break;
+}
+
+static void stop(Hda *hda, _Bool failed) {
+   if (failed)
+      __atomic_store_n(&hda->failed, 1, __ATOMIC_RELEASE);
+   __atomic_store_n(&hda->done, 1, __ATOMIC_RELEASE);
+}
+
+// a worker past the deadline or its share of the memory limit stops them all, without a solution
+static void stop_at_limit(Hda *hda, int limit) {
+   __atomic_store_n(&hda->limit, limit, __ATOMIC_RELEASE);
+   stop(hda, False);
+}
+
+static void send_batch(Hda *hda, u_int destination, Batch *batch) {
+   __atomic_add_fetch(&hda->sent, 1, __ATOMIC_ACQ_REL);
+   push_inbox(&hda->workers[destination].inbox, batch);
+}
+
+static void flush_outbox(Hda *hda, Worker *worker) {
+   for (u_int i = 0; i < hda->num_threads; i++) {
+      if (worker->outbox[i] == NULL)
+         continue;
+      send_batch(hda, i, worker->outbox[i]);
+      worker->outbox[i] = NULL;
+      worker->batches_sent++;
+   }
+   worker->since_flush = 0;
+}
+
+int send_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   Hda *hda = search->hda;
+   u_int destination = owner(hda, hash);
+   
+   if (destination == search->thread)
+      return insert_child(search, parent_id, search->thread, cost, move, hash, cursor, cells, cursor_pos, boxes);
+   
+   Worker *worker = &hda->workers[search->thread];
+   Batch *batch = worker->outbox[destination];
+   if (batch == NULL) {
+      batch = malloc(sizeof(Batch) + (size_t) hda->message_size * HDA_BATCH_MESSAGES);
+      if (batch == NULL)
+         return 1;
+      batch->count = 0;
+      worker->outbox[destination] = batch;
+   }
+   
+   Message *message = (Message *) ((u_char *) batch->messages + (size_t) hda->message_size * batch->count++);
+   message->hash = hash;
+   message->parent = parent_id;
+   message->cost = cost;
+   message->cursor = cursor;
+   message->move = move;
+   message->parent_thread = search->thread;
+   memcpy(message->boxes, cells, sizeof(u_short) * search->level->num_boxes);
+   
+   if (batch->count == HDA_BATCH_MESSAGES) {
+      send_batch(hda, destination, batch);
+      worker->outbox[destination] = NULL;
+      worker->batches_sent++;
+   }
+   return 0;
+}
+
+static int receive_batch(Search *search, Batch *batch) {
+   Hda *hda = search->hda;
+   u_int num_boxes = search->level->num_boxes;
+   _Bool push_mode = (search->expand_func == make_push);
+   Coordinate boxes[num_boxes];
+   Coordinate cursor_pos;
+   
+   for (u_int i = 0; i < batch->count; i++) {
+      Message *message = (Message *) ((u_char *) batch->messages + (size_t) hda->message_size * i);
+      
+      for (u_int j = 0; j < num_boxes; j++)
+         cell_coordinate(search, message->boxes[j], &boxes[j]);
+      cell_coordinate(search, message->cursor, &cursor_pos);
+      
+      if (insert_child(search, message->parent, message->parent_thread, message->cost, message->move,
+                       message->hash, message->cursor, message->boxes, push_mode ? NULL : &cursor_pos, boxes))
+         return 1;
+   }
+   return 0;
+}
+
+static _Bool all_idle(Hda *hda) {
+   for (u_int i = 0; i < hda->num_threads; i++)
+      if (!__atomic_load_n(&hda->workers[i].idle, __ATOMIC_ACQUIRE))
+         return False;
+   return True;
+}
+
+static void check_termination(Hda *hda) {
+   unsigned long sent = __atomic_load_n(&hda->sent, __ATOMIC_ACQUIRE);
+   unsigned long received = __atomic_load_n(&hda->received, __ATOMIC_ACQUIRE);
+   
+   if ((sent != received) || !all_idle(hda))
+      return;
+   
+   // nothing was sent or handled while the idle marks were read
+   if ((sent == __atomic_load_n(&hda->sent, __ATOMIC_ACQUIRE)) &&
+      (received == __atomic_load_n(&hda->received, __ATOMIC_ACQUIRE)))
+      stop(hda, False);
+}
+
+static void *run_worker(void *arg) {
+   Search *search = arg;
+   Hda *hda = search->hda;
+   Worker *worker = &hda->workers[search->thread];
+   
+   while (!__atomic_load_n(&hda->done, __ATOMIC_ACQUIRE)) {
+      Batch *batch;
+      while ((batch = pop_inbox(&worker->inbox)) != NULL) {
+         __atomic_store_n(&worker->idle, 0, __ATOMIC_RELEASE);
+         int error = receive_batch(search, batch);
+         free(batch);
+         worker->batches_received++;
+         __atomic_add_fetch(&hda->received, 1, __ATOMIC_ACQ_REL);
+         if (error) {
+            stop(hda, True);
+            return NULL;
+         }
+      }
+      
+      u_int state_id = remove_min_pqueue(search->states);
+      if (state_id == PQ_ABSENT) {
+         flush_outbox(hda, worker);
+         __atomic_store_n(&worker->idle, 1, __ATOMIC_RELEASE);
+         check_termination(hda);
+         sched_yield();
+         continue;
+      }
+      
+      // states that can't lead to a cheaper solution than the incumbent are dropped
+      State *state = get_state(search, state_id);
+      if (state->cost_score + state->heuristic_score >= incumbent_cost(hda))
+         continue;
+      
+      if (state->heuristic_score == 0) {
+         improve_incumbent(hda, state->cost_score, search->thread, state_id);
+         continue;
+      }
+      
+      if (search->expand_func(search, state_id)) {
+         stop(hda, True);
+         return NULL;
+      }
+      worker->expanded++;
+      if ((worker->expanded % LIMIT_CHECK_INTERVAL == 0) && over_limits(search)) {
+         stop_at_limit(hda, search->stopped);
+         return NULL;
+      }
+      if (++worker->since_flush == HDA_FLUSH_INTERVAL)
+         flush_outbox(hda, worker);
+   }
+   return NULL;
+}
+
+// the worker gets its own copy of everything the search changes, the rest is shared with search
+static int init_worker(Hda *hda, u_int thread, Search *search) {
+   Worker *worker = &hda->workers[thread];
+   Search *own = &worker->search;
+   Level *level = search->level;
+   
+   memset(worker, 0, sizeof(Worker));
+   own->level = level;
+   own->verbose = False;
+   own->stats.enabled = search->stats.enabled;
+   own->expand_func = search->expand_func;
+   own->start = search->start;
+   own->zobrist = search->zobrist;
+   own->hda = hda;
+   own->thread = thread;
+   own->deadline = search->deadline;
+   own->memory_limit = search->memory_limit / hda->num_threads;
+   
+   worker->outbox = calloc(hda->num_threads, sizeof(Batch *));
+   if (worker->outbox == NULL)
+      return 1;
+   
+   if (init_heuristic(own, search->heuristic_func) ||
+      init_arena(&own->arena, search->arena->stride) ||
+      init_table(&own->table, 1024) ||
+      init_pqueue(&own->states, search->states->kind, search->states->tie_break) ||
+      init_matching(&own->matching, level->num_boxes) ||
+      init_deadlock(own) ||
+      init_patterns(&own->patterns) ||
+      merge_patterns(own->patterns, search->patterns) ||
+      ((search->expand_func == make_push) && init_push(own)) ||
+      ((search->corral != NULL) && init_corral(own)) ||
+      ((search->macros != NULL) && init_macros(own)) ||
+      init_inbox(&worker->inbox))
+      return 1;
+   return 0;
+}
+
+static void free_worker(Worker *worker) {
+   Search *own = &worker->search;
+   
+   if (own->arena != NULL)
+      free_arena(own->arena);
+   if (own->table != NULL)
+      free_table(own->table);
+   if (own->states != NULL)
+      free_pqueue(own->states);
+   if (own->matching != NULL)
+      free_matching(own->matching);
+   free(own->cache.box_score);
+   free_deadlock(own);
+   free_patterns(own->patterns);
+   free_push(own);
+   free_corral(own);
+   free_macros(own);
+   
+   if (worker->outbox != NULL)
+      for (u_int i = 0; i < own->hda->num_threads; i++)
+         free(worker->outbox[i]);
+   free(worker->outbox);
+   if (worker->inbox.stub != NULL)
+      free_inbox(&worker->inbox);
+}
+
+// copies the solution path into the arena of search behind its root, returns the last state
+static u_int copy_solution(Hda *hda, Search *search, u_int root_id, u_char thread, u_int state_id) {
+   State *state = get_state(&hda->workers[thread].search, state_id);
+   if (state->parent == NO_STATE)
+      return root_id;
+   
+   u_int parent_id = copy_solution(hda, search, root_id, state->parent_thread, state->parent);
+   if (parent_id == NO_STATE)
+      return NO_STATE;
+   
+   u_int copy_id = alloc_arena(search->arena);
+   if (copy_id == ARENA_NULL)
+      return NO_STATE;
+   
+   State *copy = get_state(search, copy_id);
+   memcpy(copy, state, search->arena->stride);
+   copy->parent = parent_id;
+   copy->parent_thread = 0;
+   return copy_id;
+}
+
+static void print_load(Hda *hda) {
+   unsigned long total = 0, most = 0;
+   
+   for (u_int i = 0; i < hda->num_threads; i++) {
+      Worker *worker = &hda->workers[i];
+      printf("thread %u: %lu expanded, %u states, %lu batches sent, %lu received\n", i, worker->expanded,
+             worker->search.arena->length, worker->batches_sent, worker->batches_received);
+      total += worker->expanded;
+      if (worker->expanded > most)
+         most = worker->expanded;
+   }
+   if (total > 0)
+      printf("load balance: busiest thread expanded %.2f times the mean\n", (double) most * hda->num_threads / total);
+}
+
+u_int hda_search(Search *search, u_int root_id, uint64_t root_hash, u_int num_threads) {
+   Hda hda;
+   memset(&hda, 0, sizeof(Hda));
+   hda.num_threads = num_threads;
+   hda.message_size = MESSAGE_SIZE(search->level->num_boxes);
+   hda.incumbent = NO_INCUMBENT;
+   hda.workers = calloc(num_threads, sizeof(Worker));
+   if (hda.workers == NULL) {
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+      return NO_STATE;
+   }
+   
+   _Bool failed = False;
+   for (u_int i = 0; !failed && (i < num_threads); i++)
+      failed = init_worker(&hda, i, search);
+   
+   // the root is stored by its owner before any thread starts
+   if (!failed) {
+      State *root = get_state(search, root_id);
+      Search *root_owner = &hda.workers[owner(&hda, root_hash)].search;
+      u_int num_boxes = search->level->num_boxes;
+      Coordinate boxes[num_boxes];
+      Coordinate cursor_pos;
+      unpack_state(search, root, &cursor_pos, boxes);
+      failed = insert_child(root_owner, NO_STATE, 0, 0, 0, root_hash, root->current_pos, root->boxes,
+                            (search->expand_func == make_push) ? NULL : &cursor_pos, boxes);
+   }
+   
+   // threads that can't be started stop the ones that were
+   u_int started = 0;
+   for (; !failed && (started < num_threads); started++)
+      if (pthread_create(&hda.workers[started].thread, NULL, run_worker, &hda.workers[started].search)) {
+         stop(&hda, True);
+         break;
+      }
+   for (u_int i = 0; i < started; i++)
+      pthread_join(hda.workers[i].thread, NULL);
+   failed |= hda.failed;
+   
+   unsigned long nodes = 0;
+   for (u_int i = 0; !failed && (i < num_threads); i++) {
+      nodes += hda.workers[i].expanded;
+      failed = merge_patterns(search->patterns, hda.workers[i].search.patterns);
+      merge_stats(&search->stats, &hda.workers[i].search.stats);
+      if (search->corral != NULL)
+         search->corral->pruned += hda.workers[i].search.corral->pruned;
+      if (search->macros != NULL)
+         search->macros->made += hda.workers[i].search.macros->made;
+   }
+   
+   search->nodes = nodes + 1;
+   
+   // an incumbent found before a limit was reached isn't known to be optimal
+   u_int solution = NO_STATE;
+   if (!failed && (hda.limit == SEARCH_RUNNING) && (hda.incumbent != NO_INCUMBENT)) {
+      if (!search->quiet)
+         printf("Found after %lu nodes\n", nodes + 1);
+      if (!search->quiet && (search->corral != NULL))
+         printf("PI-corrals: %lu pushes pruned\n", search->corral->pruned);
+      if (!search->quiet && (search->macros != NULL))
+         printf("macros: %u goal rooms, %lu children made by a macro\n", search->macros->num_rooms, search->macros->made);
+      solution = copy_solution(&hda, search, root_id, (hda.incumbent >> 32) & 0xFF, hda.incumbent & 0xFFFFFFFF);
+      failed = (solution == NO_STATE);
+   }
+   if (!failed && !search->quiet)
+      print_load(&hda);
+   if (failed)
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+   else if (hda.limit != SEARCH_RUNNING)
+      search->stopped = hda.limit;
+   
+   for (u_int i = 0; i < num_threads; i++)
+      free_worker(&hda.workers[i]);
+   free(hda.workers);
+   return solution;
+}
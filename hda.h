@@ -0,0 +1,58 @@
+#ifndef HDA_H
+#define HDA_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "sokoban.h"
+
+#define HDA_MAX_THREADS 64
+#define HDA_BATCH_MESSAGES 64   // children sent to another thread are grouped in batches of this many
+#define HDA_FLUSH_INTERVAL 16   // expansions between two flushes of the partly filled batches
+
+// children on their way to the thread owning them
+typedef struct batch {
+   struct batch *next;
+   u_int count;
+   uint64_t messages[];
+} Batch;
+
+// lock-free queue many threads push batches in and only its owner pops from
+typedef struct {
+   Batch *head;            // last pushed, producers swap themselves in here
+   Batch *tail;            // next to pop, only touched by the owner
+   Batch *stub;            // keeps the queue non-empty so that head and tail never meet at NULL
+} Inbox;
+
+typedef struct {
+   Search search;          // own arena, state table, frontier and scratch buffers
+   Inbox inbox;
+   Batch **outbox;         // batch being filled per destination thread
+   pthread_t thread;
+   int idle;               // nothing left in the frontier, set and read atomically
+   u_int since_flush;
+   
+   unsigned long expanded;
+   unsigned long batches_sent;
+   unsigned long batches_received;
+} Worker;
+
+// hash distributed A*: every state belongs to the thread picked by its hash, which alone keeps
+// it in its state table and frontier. the children generated are sent to their owners
+typedef struct hda {
+   Worker *workers;
+   u_int num_threads;
+   u_int message_size;     // bytes per child in a batch
+   
+   uint64_t incumbent;     // best solution found: cost << 40 | thread << 32 | state id
+   unsigned long sent;     // batches pushed and batches handled, equal when none is in flight
+   unsigned long received;
+   int done;
+   int failed;
+   int limit;              // SEARCH_TIME_LIMIT or SEARCH_MEMORY_LIMIT once a worker ran past it
+} Hda;
+
+// searches with num_threads threads from the root state root_id of search whose hash is root_hash.
+// the solution path is copied back in the arena of search, returns its last state or NO_STATE
+u_int hda_search(Search *search, u_int root_id, uint64_t root_hash, u_int num_threads);
+
+#endif
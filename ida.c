@@ -0,0 +1,228 @@
+/*
+ * ida.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * IDA*: the arena is used as a stack. Expanding a state appends its children behind it, they are
+ * visited in order of heuristic and dropped again once the last one is done. So the arena only
+ * ever holds the current path and the children of the states on it, and the parent links of the
+ * solution are still in place when it is found.
+ * 
+ * The transposition table is direct mapped by hash. Entering a state stores the move score it was
+ * entered with, and a state entered again in the same iteration with a move score no lower is
+ * skipped, which also cuts cycles. Once a state is done, the lowest f found beyond the threshold
+ * under it is kept as a better lower bound than the heuristic, but only if nothing was skipped
+ * below it: a skipped state may well be on the best way on from a state reached another way.
+ * A slot is taken over by an entry of an older iteration or when the new state has as much
+ * search left below it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ida.h"
+
+#define FOUND (UINT_MAX - 1)
+#define NONE UINT_MAX
+
+static int init_ida(Ida *ida, u_int table_mb) {
+   size_t entries = 1;
+   while (entries * 2 * sizeof(Transposition) <= (size_t) table_mb << 20)
+      entries *= 2;
+   
+   memset(ida, 0, sizeof(Ida));
+   ida->table = calloc(entries, sizeof(Transposition));
+   ida->table_mask = entries - 1;
+   ida->hashes_capacity = 1024;
+   ida->hashes = malloc(sizeof(uint64_t) * ida->hashes_capacity);
+   if ((ida->table == NULL) || (ida->hashes == NULL))
+      return 1;
+   return 0;
+}
+
+static void free_ida(Ida *ida) {
+   free(ida->table);
+   free(ida->hashes);
+}
+
+static int set_hash(Ida *ida, u_int id, uint64_t hash) {
+   if (id >= ida->hashes_capacity) {
+      u_int new_capacity = ida->hashes_capacity * 2;
+      uint64_t *temp = realloc(ida->hashes, sizeof(uint64_t) * new_capacity);
+      if (temp == NULL)
+         return 1;
+      ida->hashes = temp;
+      ida->hashes_capacity = new_capacity;
+   }
+   ida->hashes[id] = hash;
+   return 0;
+}
+
+int collect_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   Ida *ida = search->ida;
+   State *parent = get_state(search, parent_id);
+   
+   // stepping straight back to the grandparent is never useful
+   if ((parent->parent != NO_STATE) && (ida->hashes[parent->parent] == hash))
+      return 0;
+   
+   uint64_t started = STATS_START(search);
+   u_int heuristic_score = child_heuristic(search, parent_id, boxes, cursor_pos);
+   STATS_STOP(search, heuristic_ticks, started);
+   if (heuristic_score == HEURISTIC_DEAD)
+      return 0;
+   
+   u_int new_id = alloc_arena(search->arena);
+   if ((new_id == ARENA_NULL) || set_hash(ida, new_id, hash))
+      return 1;
+   
+   State *new_state = get_state(search, new_id);
+   new_state->parent = parent_id;
+   new_state->move_from_parent = move;
+   new_state->current_pos = cursor;
+   memcpy(new_state->boxes, cells, sizeof(u_short) * search->level->num_boxes);
+   new_state->cost_score = cost;
+   new_state->heuristic_score = heuristic_score;
+   return 0;
+}
+
+// returns FOUND with the solution in *solution, the lowest f beyond the threshold, or NONE.
+// *skipped is set if a state below was skipped by the transposition table
+static u_int depth_first(Search *search, u_int state_id, u_int *solution, _Bool *skipped) {
+   Ida *ida = search->ida;
+   State *state = get_state(search, state_id);
+   uint64_t hash = ida->hashes[state_id];
+   u_int cost = state->cost_score;
+   u_int bound = state->heuristic_score;
+   
+   if (state->heuristic_score == 0) {
+      *solution = state_id;
+      return FOUND;
+   }
+   
+   Transposition *entry = &ida->table[hash & ida->table_mask];
+   if (entry->hash == hash) {
+      ida->table_hits++;
+      if ((entry->iteration == ida->iteration) && (entry->cost <= cost)) {
+         *skipped = True;
+         return NONE;   // searched, or being searched, from a lower move score already
+      }
+      if (entry->bound > bound)
+         bound = entry->bound;
+   }
+   if (cost + bound > ida->threshold)
+      return cost + bound;
+   
+   u_int depth = ida->threshold - cost;
+   if ((entry->hash == hash) || (entry->iteration != ida->iteration) || (depth >= entry->depth)) {
+      if (entry->hash != hash)
+         entry->bound = 0;
+      entry->hash = hash;
+      entry->cost = cost;
+      entry->depth = depth;
+      entry->iteration = ida->iteration;
+      if (bound > entry->bound)
+         entry->bound = bound;
+   } else {
+      entry = NULL;  // the slot keeps the deeper entry
+   }
+   
+   ida->nodes++;
+   if ((ida->nodes % LIMIT_CHECK_INTERVAL == 0) && over_limits(search))
+      return NONE;
+   u_int first_child = search->arena->length;
+   if (search->expand_func(search, state_id)) {
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+      return NONE;
+   }
+   u_int num_children = search->arena->length - first_child;
+   if (num_children == 0)
+      return NONE;
+   
+   // children with the lowest heuristic are visited first
+   u_int order[num_children];
+   for (u_int i = 0; i < num_children; i++) {
+      u_int j = i;
+      u_int h = get_state(search, first_child + i)->heuristic_score;
+      while ((j > 0) && (get_state(search, order[j-1])->heuristic_score > h)) {
+         order[j] = order[j-1];
+         j--;
+      }
+      order[j] = first_child + i;
+   }
+   
+   u_int lowest = NONE;
+   _Bool skipped_below = False;
+   for (u_int i = 0; i < num_children; i++) {
+      u_int result = depth_first(search, order[i], solution, &skipped_below);
+      if (result == FOUND)
+         return FOUND;
+      if (search->stopped != SEARCH_RUNNING)
+         return NONE;
+      if (result < lowest)
+         lowest = result;
+   }
+   truncate_arena(search->arena, first_child);
+   
+   if (skipped_below)
+      *skipped = True;
+   else if ((entry != NULL) && (entry->hash == hash) && (lowest != NONE) && (lowest - cost > entry->bound))
+      entry->bound = lowest - cost;
+   return lowest;
+}
+
+u_int ida_search(Search *search, u_int root_id, uint64_t root_hash, u_int table_mb) {
+   Ida ida;
+   if (init_ida(&ida, table_mb) || set_hash(&ida, root_id, root_hash)) {
+      free_ida(&ida);
+      search->stopped = SEARCH_OUT_OF_MEMORY;
+      return NO_STATE;
+   }
+   search->ida = &ida;
+   
+   State *root = get_state(search, root_id);
+   ida.threshold = root->cost_score + root->heuristic_score;
+   if (!search->quiet)
+      printf("transposition table: %u entries\n", ida.table_mask + 1);
+   
+   u_int solution = NO_STATE;
+   while (True) {
+      ida.iteration++;
+      _Bool skipped = False;
+      u_int result = depth_first(search, root_id, &solution, &skipped);
+      if (search->stopped != SEARCH_RUNNING)
+         break;
+      if (!search->quiet)
+         printf("threshold %u: %lu nodes\n", ida.threshold, ida.nodes);
+      
+      if (result == FOUND) {
+         if (!search->quiet)
+            printf("Found after %lu nodes\n", ida.nodes + 1);
+         break;
+      }
+      if (result == NONE)
+         break;
+      ida.threshold = result;
+   }
+   
+#ifdef DEBUG
+   printf("transposition table hits: %lu\n", ida.table_hits);
+#endif
+   search->nodes = ida.nodes + 1;
+   search->ida = NULL;
+   free_ida(&ida);
+   return solution;
+}
@@ -0,0 +1,36 @@
+#ifndef IDA_H
+#define IDA_H
+
+#include <stdint.h>
+#include "sokoban.h"
+
+#define IDA_DEFAULT_TABLE_MB 64
+
+// transposition table entry, one per slot
+typedef struct {
+   uint64_t hash;          // 0 for an empty slot
+   u_int cost;             // lowest move score the state was entered with in the iteration
+   u_int bound;            // lower bound on the moves left, at least the heuristic
+   u_int depth;            // threshold - cost when stored, deeper searches are kept
+   u_int iteration;
+} Transposition;
+
+// iterative deepening A*: depth first searches bounded by f, the bound rising to the lowest f
+// beyond it after every iteration. only the current path and the children of its states are
+// kept in the arena, the rest lives in a fixed size transposition table
+typedef struct ida {
+   Transposition *table;
+   u_int table_mask;
+   uint64_t *hashes;       // hash of every state in the arena, by id
+   u_int hashes_capacity;
+   u_int iteration;
+   u_int threshold;
+   unsigned long nodes;
+   unsigned long table_hits;
+} Ida;
+
+// searches from the root state root_id, the only state in the arena of search.
+// table_mb megabytes are used for the transposition table. returns the id of the solution or NO_STATE
+u_int ida_search(Search *search, u_int root_id, uint64_t root_hash, u_int table_mb);
+
+#endif
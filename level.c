@@ -0,0 +1,375 @@
+/*
+ * level.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // mmap, fstat
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "level.h"
+
+#define BOARD_CHARACTERS " #@+$*.-_"  // '-' and '_' stand for floor in XSB files
+#define READ_CHUNK 65536
+
+int open_levels(LevelFile *file, int fd) {
+   struct stat info;
+   memset(file, 0, sizeof(LevelFile));
+   if (fstat(fd, &info) != 0)
+      return 1;
+   
+   if (S_ISREG(info.st_mode)) {
+      if (info.st_size == 0)
+         return 0;
+      void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+         file->data = data;
+         file->length = info.st_size;
+         file->mapped = 1;
+         return 0;
+      }
+   }
+   
+   size_t capacity = READ_CHUNK;
+   char *data = malloc(capacity);
+   if (data == NULL)
+      return 1;
+   for (;;) {
+      if (file->length == capacity) {
+         char *temp = realloc(data, capacity *= 2);
+         if (temp == NULL) {
+            free(data);
+            return 1;
+         }
+         data = temp;
+      }
+      ssize_t count = read(fd, data + file->length, capacity - file->length);
+      if (count < 0) {
+         free(data);
+         return 1;
+      }
+      if (count == 0)
+         break;
+      file->length += count;
+   }
+   file->data = data;
+   return 0;
+}
+
+void close_levels(LevelFile *file) {
+   if (file->mapped)
+      munmap((void *) file->data, file->length);
+   else
+      free((void *) file->data);
+   file->data = NULL;
+}
+
+// next line of file without its line break, NULL at the end of the file
+static const char *next_line(LevelFile *file, size_t *length) {
+   if (file->pos >= file->length)
+      return NULL;
+   
+   const char *line = file->data + file->pos;
+   const char *end = memchr(line, '\n', file->length - file->pos);
+   *length = (end != NULL) ? (size_t) (end - line) : file->length - file->pos;
+   file->pos += *length + (end != NULL);
+   if ((*length > 0) && (line[*length - 1] == '\r'))
+      (*length)--;
+   return line;
+}
+
+static _Bool blank_line(const char *line, size_t length) {
+   for (size_t i = 0; i < length; i++)
+      if (!isspace((u_char) line[i]))
+         return 0;
+   return 1;
+}
+
+// a line of an XSB puzzle: board characters only, with at least one wall
+static _Bool board_line(const char *line, size_t length) {
+   _Bool wall = 0;
+   for (size_t i = 0; i < length; i++) {
+      if ((line[i] == 0) || (strchr(BOARD_CHARACTERS, line[i]) == NULL))
+         return 0;
+      wall |= (line[i] == '#');
+   }
+   return wall;
+}
+
+// whether the num_rows lines from file->pos are a counted puzzle rather than part of an XSB one,
+// which would go on with more board lines
+static _Bool counted_rows(LevelFile *file, u_int num_rows) {
+   size_t pos = file->pos, length = 0;
+   const char *line = NULL;
+   
+   u_int rows = 0;
+   
+   while ((NULL != (line = next_line(file, &length))) && (rows++ < num_rows))
+      continue;
+   _Bool counted = (line == NULL) || !board_line(line, length);
+   file->pos = pos;
+   return counted;
+}
+
+// puts the puzzle text of num_rows lines from file->pos in the grid, with the boxes, goal positions and cursor
+static int fill_grid(LevelFile *file, u_int num_rows, Level *level, Coordinate *start, Coordinate *boxes, char *error) {
+   u_int num_boxes = 0, num_goals = 0;
+   _Bool cursor_found = 0;
+   
+   memset(level->grid, GRID_OUTSIDE, level->num_cells);
+   for (u_int row = 0; row < num_rows; row++) {
+      size_t length = 0;
+      const char *line = next_line(file, &length);
+      u_int x = row + LEVEL_PADDING;
+      
+      for (size_t i = 0; i < length; i++) {
+         u_int y = i + LEVEL_PADDING;
+         char *cell = &level->grid[x * level->width + y];
+         Coordinate pos = { x, y };
+         
+         switch (line[i]) {
+            case ' ':
+            case '-':
+            case '_':
+               *cell = ' ';
+               break;
+            case '#':
+               *cell = '#';
+               break;
+            case '*':
+               *cell = '.';
+               level->goal_positions[num_goals++] = pos;
+               boxes[num_boxes++] = pos;
+               break;
+            case '$':
+               *cell = ' ';
+               boxes[num_boxes++] = pos;
+               break;
+            case '+':
+               *cell = '.';
+               level->goal_positions[num_goals++] = pos;
+               *start = pos;
+               cursor_found = 1;
+               break;
+            case '.':
+               *cell = '.';
+               level->goal_positions[num_goals++] = pos;
+               break;
+            case '@':
+               *cell = ' ';
+               *start = pos;
+               cursor_found = 1;
+               break;
+            default:
+               snprintf(error, LEVEL_ERROR_SIZE, "Unknown character: %c", line[i]);
+               return 1;
+         }
+      }
+   }
+   
+   if (num_boxes != num_goals)
+      snprintf(error, LEVEL_ERROR_SIZE, "Number of boxes and goal positions differ");
+   else if (num_boxes > LEVEL_MAX_BOXES)
+      snprintf(error, LEVEL_ERROR_SIZE, "More than %d boxes", LEVEL_MAX_BOXES);
+   else if (!cursor_found)
+      snprintf(error, LEVEL_ERROR_SIZE, "No cursor in puzzle");
+   level->num_boxes = num_boxes;
+   return error[0] != 0;
+}
+
+int read_level(LevelFile *file, Level *level, Coordinate *start, Coordinate **boxes_ptr, char *error) {
+   const char *line;
+   size_t length, first_row;
+   u_int num_rows = 0;
+   _Bool counted = 0;
+   error[0] = 0;
+   
+   // the puzzle starts at the first line holding a number or a board line, anything else is skipped
+   for (;;) {
+      first_row = file->pos;
+      if (NULL == (line = next_line(file, &length)))
+         return LEVEL_END;
+      if (blank_line(line, length))
+         continue;
+      if (isdigit((u_char) line[0])) {
+         num_rows = strtol(line, NULL, 10);
+         if (num_rows == 0) {
+            snprintf(error, LEVEL_ERROR_SIZE, "Incorrect format of file");
+            return LEVEL_INVALID;
+         }
+         if (counted_rows(file, num_rows)) {
+            counted = 1;
+            first_row = file->pos;
+            break;
+         }
+         continue;   // the title of an XSB puzzle
+      }
+      if (board_line(line, length)) {
+         file->pos = first_row;
+         break;
+      }
+   }
+   
+   // the size of the grid is known once every line of the puzzle has been seen
+   size_t max_length = 0;
+   u_int rows = 0;
+   for (;;) {
+      size_t end = file->pos;
+      if (counted && (rows == num_rows))
+         break;
+      if ((NULL == (line = next_line(file, &length))) || (!counted && !board_line(line, length))) {
+         file->pos = end;
+         break;
+      }
+      if (length > max_length)
+         max_length = length;
+      rows++;
+   }
+   size_t after = file->pos;
+   
+   level->height = rows + 2 * LEVEL_PADDING;
+   level->width = max_length + 2 * LEVEL_PADDING;
+   if ((size_t) level->height * level->width > CELL_LIMIT) {
+      snprintf(error, LEVEL_ERROR_SIZE, "Puzzle too large");
+      return LEVEL_INVALID;
+   }
+   level->num_cells = level->height * level->width;
+   level->grid = malloc(level->num_cells);
+   level->goal_positions = malloc(sizeof(Coordinate) * level->num_cells);
+   Coordinate *boxes = malloc(sizeof(Coordinate) * level->num_cells);
+   
+   file->pos = first_row;
+   if ((level->grid == NULL) || (level->goal_positions == NULL) || (boxes == NULL))
+      snprintf(error, LEVEL_ERROR_SIZE, "Memory Error");
+   else
+      fill_grid(file, rows, level, start, boxes, error);
+   file->pos = after;
+   
+   if (error[0] != 0) {
+      free(level->grid);
+      free(level->goal_positions);
+      free(boxes);
+      return LEVEL_INVALID;
+   }
+   
+   // the arrays are only shrunk, if that fails the larger ones are kept
+   Coordinate *temp = realloc(boxes, sizeof(Coordinate) * (level->num_boxes + 1));
+   *boxes_ptr = (temp != NULL) ? temp : boxes;
+   temp = realloc(level->goal_positions, sizeof(Coordinate) * (level->num_boxes + 1));
+   if (temp != NULL)
+      level->goal_positions = temp;
+   if (init_level(level)) {
+      free_level(level);
+      free(*boxes_ptr);
+      snprintf(error, LEVEL_ERROR_SIZE, "Memory Error");
+      return LEVEL_INVALID;
+   }
+   return LEVEL_OK;
+}
+
+static void init_walls(Level *level) {
+   for (u_int i = 0; i < level->num_cells; i++)
+      level->walls[i] = (level->grid[i] == '#') || (level->grid[i] == GRID_OUTSIDE);
+}
+
+/*
+ * reverse BFS from the goal: a box reaches cell b with one push in direction d if it stood on
+ * b-d and the cursor could stand on b-2d. So walking backwards from the goal, a pull from b to b-d
+ * is possible whenever both b-d and b-2d are not walls.
+ * other boxes are ignored, which keeps the distance a lower bound on the real number of pushes
+ */
+static void goal_distances(Level *level, u_int goal, u_short *dist, u_short *queue) {
+   int *offsets = level->offsets;
+   u_int head = 0, tail = 0;
+   
+   for (u_int i = 0; i < level->num_cells; i++)
+      dist[i] = UNREACHABLE;
+   
+   u_short start = level_cell(level, &level->goal_positions[goal]);
+   dist[start] = 0;
+   queue[tail++] = start;
+   
+   while (head < tail) {
+      u_short cell = queue[head++];
+      for (int mv = 0; mv < 4; mv++) {
+         int from = cell - offsets[mv];
+         int cursor = from - offsets[mv];
+         if ((cursor < 0) || ((u_int) cursor >= level->num_cells))
+            continue;
+         if (level->walls[from] || level->walls[cursor] || (dist[from] != UNREACHABLE))
+            continue;
+         dist[from] = dist[cell] + 1;
+         queue[tail++] = from;
+      }
+   }
+}
+
+int init_level(Level *level) {
+   level->num_cells = level->height * level->width;
+   level->offsets[0] = -(int) level->width;
+   level->offsets[1] = level->width;
+   level->offsets[2] = -1;
+   level->offsets[3] = 1;
+   level->walls = malloc(sizeof(u_char) * level->num_cells);
+   level->push_dist = malloc(sizeof(u_short) * level->num_cells * level->num_boxes);
+   level->min_push_dist = malloc(sizeof(u_short) * level->num_cells);
+   level->dead = malloc(sizeof(u_char) * level->num_cells);
+   u_short *queue = malloc(sizeof(u_short) * level->num_cells);
+   
+   if ((level->walls == NULL) || (level->push_dist == NULL) || (level->min_push_dist == NULL) ||
+      (level->dead == NULL) || (queue == NULL)) {
+      free(queue);
+      return 1;
+   }
+   
+   init_walls(level);
+   
+   for (u_int i = 0; i < level->num_cells; i++)
+      level->min_push_dist[i] = UNREACHABLE;
+   
+   for (u_int goal = 0; goal < level->num_boxes; goal++) {
+      u_short *dist = level->push_dist + goal * level->num_cells;
+      goal_distances(level, goal, dist, queue);
+      
+      for (u_int i = 0; i < level->num_cells; i++)
+         if (dist[i] < level->min_push_dist[i])
+            level->min_push_dist[i] = dist[i];
+   }
+   
+   /*
+    * a cell no goal position can be pulled back to is dead: a box pushed there can never be solved,
+    * whatever the other boxes do. this covers corners and wall edges without a goal position or an
+    * exit, as well as any other cell whose every way out needs the cursor inside a wall
+    */
+   for (u_int i = 0; i < level->num_cells; i++)
+      level->dead[i] = !level->walls[i] && (level->min_push_dist[i] == UNREACHABLE);
+   
+   free(queue);
+   return 0;
+}
+
+void free_level(Level *level) {
+   free(level->grid);
+   free(level->goal_positions);
+   free(level->walls);
+   free(level->push_dist);
+   free(level->min_push_dist);
+   free(level->dead);
+}
@@ -0,0 +1,82 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stddef.h>
+#include <limits.h>
+#include "types.h"
+
+#define UNREACHABLE USHRT_MAX
+#define CELL_LIMIT 65536  // cells are stored in 16 bits
+#define LEVEL_MAX_BOXES (UCHAR_MAX - 1)  // box ids + 1 are stored in bytes (see Search.box_map)
+#define LEVEL_PADDING 1   // rows and columns of walls around the puzzle, no floor cell is on the edge of the grid
+
+// return codes of read_level
+#define LEVEL_OK 0
+#define LEVEL_END 1        // no puzzle left in the file
+#define LEVEL_INVALID 2    // the reason is written to the error buffer
+#define LEVEL_ERROR_SIZE 100
+
+// grid cells that were not part of the puzzle text: the padding and the cells past the end of a short line
+#define GRID_OUTSIDE 0
+
+typedef struct {
+   int x;
+   int y;
+} Coordinate;
+
+// text of a puzzle file, mapped in memory, or read whole when it can't be mapped (a pipe)
+typedef struct {
+   const char *data;
+   size_t length;
+   size_t pos;             // start of the next line to read
+   _Bool mapped;
+} LevelFile;
+
+// static description of a puzzle and of the tables precomputed from it, shared by every search over it.
+// the puzzle is one contiguous grid of height rows of width cells, cells are numbered x*width + y
+typedef struct {
+   char *grid;             // '#' for walls, '.' for goal positions, ' ' for floor, or GRID_OUTSIDE
+   u_int height;
+   u_int width;            // length of the widest line plus the padding
+   u_int num_cells;
+   int offsets[4];         // cell offsets of the four moves, in the order up, down, left, right
+   Coordinate *goal_positions;
+   u_int num_boxes;        // also the number of goal positions
+   
+   u_char *walls;          // 1 for walls and for the cells outside of the puzzle
+   u_short *push_dist;     // push_dist[goal*num_cells + cell]: minimum pushes to get a box from cell to goal
+   u_short *min_push_dist; // minimum of push_dist over all the goals
+   u_char *dead;           // 1 for floor cells a box can never be taken from to any goal position
+} Level;
+
+// maps the file open as fd, returns 1 if it can't be read
+int open_levels(LevelFile *file, int fd);
+
+void close_levels(LevelFile *file);
+
+/*
+ * reads the next puzzle of file and initializes level with it, returns LEVEL_OK, LEVEL_END or LEVEL_INVALID.
+ * start gets the cursor and boxes an array of the boxes the caller frees.
+ * a puzzle is either a line holding its number of lines followed by them, or an XSB puzzle: a run
+ * of lines made of board characters only, between titles, comments or empty lines which are skipped
+ */
+int read_level(LevelFile *file, Level *level, Coordinate *start, Coordinate **boxes, char *error);
+
+// builds the precomputed tables, grid, sizes and goal positions have to be set already
+int init_level(Level *level);
+
+void free_level(Level *level);
+
+static inline u_short level_cell(Level *level, Coordinate *pos) {
+   return pos->x * level->width + pos->y;
+}
+
+static inline u_short push_distance(Level *level, Coordinate *box, u_int goal) {
+   return level->push_dist[goal * level->num_cells + level_cell(level, box)];
+}
+
+static inline u_short min_push_distance(Level *level, Coordinate *box) {
+   return level->min_push_dist[level_cell(level, box)];
+}
+
+#endif
@@ -0,0 +1,353 @@
+/*
+ * macro.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Macro pushes for the push mode, making one child out of a chain of pushes of the same box:
+ * 
+ * Tunnels: a box pushed onto a cell with walls on both sides, from a cell with walls on both sides,
+ * leaves the cursor nothing to do around it but to push on or to walk back. It is pushed on until it
+ * gets out of the tunnel, onto a goal position or in front of something.
+ * 
+ * Goal rooms: floor with goal positions that a box can only get to through one corridor cell, the
+ * entrance. The order the room is filled in is worked out beforehand, the farthest goal position first
+ * as long as the others can still be reached. A box pushed onto the entrance while the room holds
+ * boxes on the first goal positions of that order only is pushed straight to the next one.
+ * 
+ * Each child costs all of its pushes. The boxes never stop in a tunnel nor anywhere else in a room,
+ * so the solutions are the shortest ones under that rule and may not be push optimal.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+
+// the two sides of a cell across the direction of move mv are walls
+static _Bool corridor(Level *level, u_short cell, int mv) {
+   int side = level->offsets[(mv < 2) ? 2 : 0];
+   return level->walls[cell - side] && level->walls[cell + side];
+}
+
+// scratch space of the searches of a room
+typedef struct {
+   u_char *allowed;        // cells the box and the cursor stay on, the room with its entrance and the cell before it
+   u_char *blocked;        // goal positions filled so far
+   u_int *dist;            // dist[cell*4 + mv]: pushes to get the box to cell with the cursor behind it after move mv
+   u_int *queue;
+   u_int *marks;
+   u_int stamp;
+   u_short *cells;         // queue of the cursor floods
+   u_short *room;          // cells of the room being looked at
+} RoomSearch;
+
+// marks with a fresh stamp the cells the cursor can walk to from start, around the box
+static u_int flood_cursor(Level *level, RoomSearch *rs, u_short start, u_short box) {
+   u_int stamp = ++rs->stamp;
+   u_int head = 0, tail = 0;
+   
+   rs->cells[tail++] = start;
+   rs->marks[start] = stamp;
+   while (head < tail) {
+      u_short cell = rs->cells[head++];
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + level->offsets[mv];
+         if (!rs->allowed[next] || rs->blocked[next] || (next == box) || (rs->marks[next] == stamp))
+            continue;
+         rs->marks[next] = stamp;
+         rs->cells[tail++] = next;
+      }
+   }
+   return stamp;
+}
+
+// breadth first search over the pushes of a lone box from the entrance, the cursor standing before it
+static void push_distances(Level *level, RoomSearch *rs, Room *room) {
+   int *offsets = level->offsets;
+   u_int head = 0, tail = 0;
+   
+   for (u_int i = 0; i < level->num_cells * 4; i++)
+      rs->dist[i] = UINT_MAX;
+   rs->dist[room->entrance * 4 + room->direction] = 0;
+   rs->queue[tail++] = room->entrance * 4 + room->direction;
+   while (head < tail) {
+      u_int node = rs->queue[head++];
+      u_short box = node / 4;
+      u_int stamp = flood_cursor(level, rs, box - offsets[node % 4], box);
+      
+      for (int mv = 0; mv < 4; mv++) {
+         u_short to = box + offsets[mv];
+         u_int next = to * 4 + mv;
+         if ((rs->marks[box - offsets[mv]] != stamp) || !rs->allowed[to] || rs->blocked[to] ||
+            (rs->dist[next] != UINT_MAX))
+            continue;
+         rs->dist[next] = rs->dist[node] + 1;
+         rs->queue[tail++] = next;
+      }
+   }
+}
+
+// fewest pushes to get the box to cell, UINT_MAX if it can't be, with the cell of the cursor after them
+static u_int room_distance(Level *level, RoomSearch *rs, u_short cell, u_short *behind) {
+   u_int best = UINT_MAX;
+   for (int mv = 0; mv < 4; mv++)
+      if (rs->dist[cell * 4 + mv] < best) {
+         best = rs->dist[cell * 4 + mv];
+         *behind = cell - level->offsets[mv];
+      }
+   return best;
+}
+
+// fills the room from the farthest goal position the others can still be reached after, one at a time
+static int packing_order(Level *level, RoomSearch *rs, Room *room, u_short *goals, u_int num_goals) {
+   room->order = malloc(sizeof(u_short) * num_goals);
+   room->pushes = malloc(sizeof(u_int) * num_goals);
+   room->behind = malloc(sizeof(u_short) * num_goals);
+   u_int *distance = malloc(sizeof(u_int) * num_goals);
+   u_short *behind = malloc(sizeof(u_short) * num_goals);
+   if ((room->order == NULL) || (room->pushes == NULL) || (room->behind == NULL) ||
+      (distance == NULL) || (behind == NULL)) {
+      free(distance);
+      free(behind);
+      return 1;
+   }
+   
+   room->num_order = 0;
+   while (room->num_order < num_goals) {
+      push_distances(level, rs, room);
+      for (u_int i = 0; i < num_goals; i++)
+         distance[i] = rs->blocked[goals[i]] ? UINT_MAX : room_distance(level, rs, goals[i], &behind[i]);
+      
+      // candidates from the farthest, UINT_MAX ones can't be reached
+      _Bool placed = False;
+      for (;;) {
+         u_int pick = num_goals;
+         for (u_int i = 0; i < num_goals; i++)
+            if ((distance[i] != UINT_MAX) && ((pick == num_goals) || (distance[i] > distance[pick])))
+               pick = i;
+         if (pick == num_goals)
+            break;
+         
+         rs->blocked[goals[pick]] = 1;
+         push_distances(level, rs, room);
+         _Bool reachable = True;
+         for (u_int i = 0; reachable && (i < num_goals); i++) {
+            u_short unused;
+            reachable = rs->blocked[goals[i]] || (room_distance(level, rs, goals[i], &unused) != UINT_MAX);
+         }
+         if (reachable) {
+            room->order[room->num_order] = goals[pick];
+            room->pushes[room->num_order] = distance[pick];
+            room->behind[room->num_order] = behind[pick];
+            room->num_order++;
+            placed = True;
+            break;
+         }
+         rs->blocked[goals[pick]] = 0;
+         distance[pick] = UINT_MAX;
+      }
+      if (!placed)
+         break;
+   }
+   
+   for (u_int i = 0; i < num_goals; i++)
+      rs->blocked[goals[i]] = 0;
+   free(distance);
+   free(behind);
+   return 0;
+}
+
+/*
+ * looks for a room behind the corridor cell entrance in the direction of move mv, it is added with its
+ * packing order unless some of its cells are in another room already
+ */
+static int find_room(Search *search, RoomSearch *rs, u_short entrance, int mv) {
+   Level *level = search->level;
+   Macros *macros = search->macros;
+   int *offsets = level->offsets;
+   u_short before = entrance - offsets[mv], inside = entrance + offsets[mv];
+   
+   // the room starts right behind its entrance, not further down the corridor
+   if (level->walls[before] || level->walls[inside] || (level->grid[entrance] == '.') ||
+      !corridor(level, entrance, mv) || ((level->grid[inside] != '.') && corridor(level, inside, mv)))
+      return 0;
+   
+   u_int stamp = ++rs->stamp;
+   u_int head = 0, size = 0, num_goals = 0;
+   rs->marks[entrance] = stamp;
+   rs->marks[inside] = stamp;
+   rs->room[size++] = inside;
+   while (head < size) {
+      u_short cell = rs->room[head++];
+      if (cell == before)
+         return 0;       // the entrance is not the only way in
+      num_goals += (level->grid[cell] == '.');
+      for (int dir = 0; dir < 4; dir++) {
+         u_short next = cell + offsets[dir];
+         if (level->walls[next] || (rs->marks[next] == stamp))
+            continue;
+         rs->marks[next] = stamp;
+         rs->room[size++] = next;
+      }
+   }
+   if ((num_goals == 0) || (macros->num_rooms == UCHAR_MAX))
+      return 0;
+   for (u_int i = 0; i < size; i++)
+      if (macros->room_of[rs->room[i]])
+         return 0;
+   
+   u_short *goals = malloc(sizeof(u_short) * num_goals);
+   if (goals == NULL)
+      return 1;
+   num_goals = 0;
+   for (u_int i = 0; i < size; i++) {
+      rs->allowed[rs->room[i]] = 1;
+      if (level->grid[rs->room[i]] == '.')
+         goals[num_goals++] = rs->room[i];
+   }
+   rs->allowed[entrance] = rs->allowed[before] = 1;
+   
+   Room *room = &macros->rooms[macros->num_rooms++];
+   room->entrance = entrance;
+   room->direction = mv;
+   int failed = packing_order(level, rs, room, goals, num_goals);
+   
+   for (u_int i = 0; i < size; i++) {
+      rs->allowed[rs->room[i]] = 0;
+      macros->room_of[rs->room[i]] = macros->num_rooms;
+   }
+   rs->allowed[entrance] = rs->allowed[before] = 0;
+   free(goals);
+   return failed;
+}
+
+int init_macros(Search *search) {
+   Level *level = search->level;
+   u_int num_cells = level->num_cells;
+   Macros *macros = calloc(1, sizeof(Macros));
+   search->macros = macros;
+   if (macros == NULL)
+      return 1;
+   
+   macros->tunnel = calloc(num_cells, sizeof(u_char));
+   macros->room_of = calloc(num_cells, sizeof(u_char));
+   macros->rooms = calloc(level->num_boxes + 1, sizeof(Room));
+   RoomSearch rs;
+   rs.allowed = calloc(num_cells, sizeof(u_char));
+   rs.blocked = calloc(num_cells, sizeof(u_char));
+   rs.dist = malloc(sizeof(u_int) * num_cells * 4);
+   rs.queue = malloc(sizeof(u_int) * num_cells * 4);
+   rs.marks = calloc(num_cells, sizeof(u_int));
+   rs.stamp = 0;
+   rs.cells = malloc(sizeof(u_short) * num_cells);
+   rs.room = malloc(sizeof(u_short) * num_cells);
+   
+   int failed = (macros->tunnel == NULL) || (macros->room_of == NULL) || (macros->rooms == NULL) ||
+                (rs.allowed == NULL) || (rs.blocked == NULL) || (rs.dist == NULL) || (rs.queue == NULL) ||
+                (rs.marks == NULL) || (rs.cells == NULL) || (rs.room == NULL);
+   
+   for (u_int cell = 0; !failed && (cell < num_cells); cell++) {
+      if (level->walls[cell])
+         continue;
+      for (int mv = 0; mv < 4; mv++) {
+         u_short from = cell - level->offsets[mv];
+         if (!level->walls[from] && (level->grid[cell] != '.') && corridor(level, cell, mv) && corridor(level, from, mv))
+            macros->tunnel[cell] |= 1 << mv;
+         failed = failed || find_room(search, &rs, cell, mv);
+      }
+   }
+   
+   free(rs.allowed);
+   free(rs.blocked);
+   free(rs.dist);
+   free(rs.queue);
+   free(rs.marks);
+   free(rs.cells);
+   free(rs.room);
+   return failed;
+}
+
+void free_macros(Search *search) {
+   Macros *macros = search->macros;
+   if (macros == NULL)
+      return;
+   for (u_int i = 0; i < macros->num_rooms; i++) {
+      free(macros->rooms[i].order);
+      free(macros->rooms[i].pushes);
+      free(macros->rooms[i].behind);
+   }
+   free(macros->tunnel);
+   free(macros->room_of);
+   free(macros->rooms);
+   free(macros);
+   search->macros = NULL;
+}
+
+// goal positions of the packing order of room filled, UINT_MAX if its boxes are not on the first ones only
+static u_int filled_goals(Search *search, u_short *cells, u_int room) {
+   u_int count = 0;
+   for (u_int i = 0; i < search->level->num_boxes; i++)
+      count += (search->macros->room_of[cells[i]] == room + 1);
+   
+   Room *ptr = &search->macros->rooms[room];
+   if (count > ptr->num_order)
+      return UINT_MAX;
+   for (u_int j = 0; j < count; j++)
+      if (!search->box_map[ptr->order[j]])
+         return UINT_MAX;
+   return count;
+}
+
+static void move_box(Search *search, u_short *cells, u_int box_id, u_short to) {
+   search->box_map[cells[box_id]] = 0;
+   search->box_map[to] = box_id + 1;
+   cells[box_id] = to;
+}
+
+u_int extend_push(Search *search, u_short *cells, u_int box_id, int mv, u_short *behind) {
+   Level *level = search->level;
+   Macros *macros = search->macros;
+   u_int pushes = 0;
+   
+   for (;;) {
+      u_short box = cells[box_id];
+      for (u_int i = 0; i < macros->num_rooms; i++) {
+         Room *room = &macros->rooms[i];
+         if ((room->entrance != box) || (room->direction != mv))
+            continue;
+         
+         u_int filled = filled_goals(search, cells, i);
+         if (filled < room->num_order) {
+            move_box(search, cells, box_id, room->order[filled]);
+            *behind = room->behind[filled];
+            pushes += room->pushes[filled];
+         }
+         if (pushes > 0)
+            macros->made++;
+         return pushes;
+      }
+      
+      u_short next = box + level->offsets[mv];
+      if (!(macros->tunnel[box] & (1 << mv)) || level->walls[next] || level->dead[next] || search->box_map[next]) {
+         if (pushes > 0)
+            macros->made++;
+         return pushes;
+      }
+      move_box(search, cells, box_id, next);
+      *behind = box;
+      pushes++;
+   }
+}
@@ -0,0 +1,36 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "sokoban.h"
+
+// goal room: floor holding goal positions that boxes can only get into through one corridor cell
+typedef struct {
+   u_short entrance;       // corridor cell a box is pushed onto before it enters the room
+   u_char direction;       // push moving a box from the entrance into the room
+   u_int num_order;        // goal positions of the packing order, filled one after the other
+   u_short *order;
+   u_int *pushes;          // pushes[j]: pushes from the entrance to order[j] once order[0..j-1] are filled
+   u_short *behind;        // behind[j]: cell of the cursor after the last of those pushes
+} Room;
+
+// tunnels and goal rooms of the level, found when the search is set up
+typedef struct macros {
+   u_char *tunnel;         // tunnel[cell]: bit mv set if a box pushed onto cell by move mv is pushed on
+   u_char *room_of;        // room_of[cell]: index + 1 of the room holding cell, 0 outside of the rooms
+   Room *rooms;
+   u_int num_rooms;
+   unsigned long made;     // children made by a macro
+} Macros;
+
+int init_macros(Search *search);
+
+void free_macros(Search *search);
+
+/*
+ * goes on with the push of box box_id by move mv, just made in cells and search->box_map: through the
+ * tunnel it was pushed into, or to the next goal position of the room it was pushed at the entrance of.
+ * returns the pushes added, behind is set to the cell of the cursor after the last one
+ */
+u_int extend_push(Search *search, u_short *cells, u_int box_id, int mv, u_short *behind);
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * main.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Command line front end: reads the options and the puzzle, and prints what the solver (solver.c) finds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sokoban.h"
+#include "solver.h"
+#include "hda.h"
+#include "ara.h"
+#include "batch.h"
+
+void err_exit(char *msg) {
+   fprintf(stderr, "%s\n", msg);
+   exit(1);
+}
+
+void help(char *prog_name) {
+   printf("usage: %s [--help] | [--silent] [--heap] [--tie-break=h|g|none] [--push] [--patterns=FILE] [--threads=N] [--ida] [--tt-size=MB] [--bidirectional]\n\
+          [--batch=PATH] [--time-limit=SEC] [--memory-limit=MB] [--spill=DIR] [--anytime[=W]] [--beam=WIDTH]\n\
+          [--cache=FILE] [--symmetry] [--corrals] [--macros] [--stats=json] [heuristic algorithm]\n\
+\n\
+   Simple Sokoban puzzle solver\n\
+   Puzzle is read from stdin, as its number of lines followed by them or in the XSB format\n\
+\n\
+   Default heuristic algorithm is fixed_penalty\n\
+   Available Heuristic Algorithms:\n\
+      count_boxes\n\
+      fixed_penalty\n\
+      coarse_match\n\
+      match_closest\n\
+      min_matching\n\
+\n\
+   optional arguments:\n\
+   --help                  show this help message and exit\n\
+   --silent                Don't print intermediary states\n\
+   --heap                  Keep the frontier in a binary heap instead of f-indexed buckets\n\
+   --tie-break=h|g|none    Among states of equal f prefer the lowest h (default), the lowest g or the newest\n\
+   --push                  Search over box pushes instead of single steps, solutions are push optimal\n\
+   --patterns=FILE         Load the deadlock patterns learned by earlier runs from FILE and save them back\n\
+   --threads=N             Search with N threads, each owning the states whose hash falls to it\n\
+   --ida                   Iterative deepening A*, memory is bounded by the transposition table\n\
+   --tt-size=MB            Size of the transposition table of --ida in megabytes (default 64)\n\
+   --bidirectional         Push forward from the start and pull backward from the goal until they meet\n\
+   --batch=PATH            Solve every puzzle of a file or a directory, --threads=N puzzles at a time\n\
+   --time-limit=SEC        Give up on a puzzle after SEC seconds of searching\n\
+   --memory-limit=MB       Give up on a puzzle once its states take more than MB megabytes\n\
+   --spill=DIR             Over the memory limit write the states to files in DIR instead of giving up\n\
+   --anytime[=W]           Weighted passes starting at W (default 3) printing every better solution, until\n\
+                           the time limit or the optimum is reached\n\
+   --beam=WIDTH            Keep the WIDTH best states by heuristic per depth, widening the beam on failure\n\
+   --cache=FILE            Answer puzzles solved before from FILE, and add the optimal solutions found to it\n\
+   --symmetry              Keep one of the states that are rotations or mirrors of each other on a symmetric level\n\
+   --corrals               With --push, only make the pushes of a PI-corral when there is one\n\
+   --macros                With --push, push boxes through tunnels and into goal rooms as one move, solutions\n\
+                           may not be push optimal\n\
+   --stats=json            Print the search counters and the time spent in each phase on stderr\n", prog_name);
+   exit(1);
+}
+
+int main(int argc, char **argv) {
+   Options options;
+   default_options(&options);
+   
+   char *pattern_file = NULL;
+   char *batch_path = NULL;
+   
+   for (int ind = 1; ind < argc; ind++) {
+      if (strcmp(argv[ind], "--silent") == 0)
+         options.verbose = False;
+      else if (strcmp(argv[ind], "--help") == 0)
+         help(argv[0]);
+      else if (strcmp(argv[ind], "--heap") == 0)
+         options.frontier_kind = PQ_HEAP;
+      else if (strcmp(argv[ind], "--tie-break=h") == 0)
+         options.tie_break = PQ_TIE_LOW_H;
+      else if (strcmp(argv[ind], "--tie-break=g") == 0)
+         options.tie_break = PQ_TIE_LOW_G;
+      else if (strcmp(argv[ind], "--tie-break=none") == 0)
+         options.tie_break = PQ_TIE_NONE;
+      else if (strcmp(argv[ind], "--push") == 0)
+         options.push_mode = True;
+      else if (strncmp(argv[ind], "--patterns=", 11) == 0)
+         pattern_file = argv[ind] + 11;
+      else if (strcmp(argv[ind], "--bidirectional") == 0)
+         options.bidir_mode = options.push_mode = True;
+      else if (strcmp(argv[ind], "--anytime") == 0)
+         options.anytime_weight = ARA_DEFAULT_WEIGHT;
+      else if (strncmp(argv[ind], "--anytime=", 10) == 0) {
+         options.anytime_weight = strtod(argv[ind] + 10, NULL);
+         if (options.anytime_weight < 1)
+            err_exit("Anytime weight out of range");
+      }
+      else if (strcmp(argv[ind], "--symmetry") == 0)
+         options.symmetry = True;
+      else if (strcmp(argv[ind], "--corrals") == 0)
+         options.corral_pruning = True;
+      else if (strcmp(argv[ind], "--macros") == 0)
+         options.macro_pushes = True;
+      else if (strcmp(argv[ind], "--ida") == 0)
+         options.ida_mode = True;
+      else if (strncmp(argv[ind], "--beam=", 7) == 0) {
+         options.beam_width = strtol(argv[ind] + 7, NULL, 10);
+         if (options.beam_width < 1)
+            err_exit("Beam width out of range");
+      }
+      else if (strncmp(argv[ind], "--tt-size=", 10) == 0) {
+         options.table_mb = strtol(argv[ind] + 10, NULL, 10);
+         if (options.table_mb < 1)
+            err_exit("Transposition table size out of range");
+      }
+      else if (strncmp(argv[ind], "--threads=", 10) == 0) {
+         options.num_threads = strtol(argv[ind] + 10, NULL, 10);
+         if (options.num_threads < 1)
+            err_exit("Number of threads out of range");
+      }
+      else if (strncmp(argv[ind], "--spill=", 8) == 0)
+         options.spill_dir = argv[ind] + 8;
+      else if (strcmp(argv[ind], "--stats=json") == 0)
+         options.stats = True;
+      else if (strncmp(argv[ind], "--stats=", 8) == 0)
+         err_exit("Unknown statistics format, only json is supported");
+      else if (strncmp(argv[ind], "--batch=", 8) == 0)
+         batch_path = argv[ind] + 8;
+      else if (strncmp(argv[ind], "--time-limit=", 13) == 0) {
+         options.time_limit = strtod(argv[ind] + 13, NULL);
+         if (options.time_limit <= 0)
+            err_exit("Time limit out of range");
+      }
+      else if (strncmp(argv[ind], "--memory-limit=", 15) == 0) {
+         options.memory_limit = (size_t) strtol(argv[ind] + 15, NULL, 10) << 20;
+         if (options.memory_limit == 0)
+            err_exit("Memory limit out of range");
+      }
+      else if (strncmp(argv[ind], "--cache=", 8) == 0)
+         options.cache_file = argv[ind] + 8;
+      else if (set_heuristic(&options, argv[ind])) {
+         char buff[100];
+         snprintf(buff, 100, "Unrecognised Algorithm: %s\n", argv[ind]); 
+         err_exit(buff);
+      }
+   }
+   
+   if (options.num_threads > ((batch_path != NULL) ? BATCH_MAX_THREADS : HDA_MAX_THREADS))
+      err_exit("Number of threads out of range");
+   if ((options.spill_dir != NULL) && (options.memory_limit == 0))
+      err_exit("--spill needs a --memory-limit");
+   if ((options.spill_dir != NULL) && (options.ida_mode || options.bidir_mode ||
+      (options.num_threads > 1 && batch_path == NULL)))
+      err_exit("--spill works with the A* search only");
+   
+   if (options.ida_mode && (options.num_threads > 1 && batch_path == NULL))
+      err_exit("--ida can't be combined with --threads");
+   if (options.bidir_mode && (options.ida_mode || (options.num_threads > 1 && batch_path == NULL)))
+      err_exit("--bidirectional can't be combined with --ida or --threads");
+   if ((options.beam_width > 0) && (options.ida_mode || options.bidir_mode || (options.spill_dir != NULL) ||
+      (options.anytime_weight > 0) || (options.num_threads > 1) || (batch_path != NULL)))
+      err_exit("--beam can't be combined with the other search modes");
+   if ((options.anytime_weight > 0) && (options.ida_mode || options.bidir_mode || (options.spill_dir != NULL) ||
+      (options.num_threads > 1 && batch_path == NULL)))
+      err_exit("--anytime works with the A* search only");
+   if (options.symmetry && (options.ida_mode || options.bidir_mode || (options.spill_dir != NULL) ||
+      (options.anytime_weight > 0) || (options.beam_width > 0) || (options.num_threads > 1 && batch_path == NULL)))
+      err_exit("--symmetry works with the A* search only");
+   if (options.corral_pruning && (!options.push_mode || options.bidir_mode))
+      err_exit("--corrals works with the forward push mode only");
+   if (options.macro_pushes && (!options.push_mode || options.bidir_mode))
+      err_exit("--macros works with the forward push mode only");
+   
+   if (batch_path != NULL) {
+      if (options.ida_mode || options.bidir_mode)
+         err_exit("--batch runs the A* search only");
+      switch (run_batch(batch_path, &options, options.num_threads, pattern_file)) {
+         case (BATCH_SOLVED):
+            return 0;
+         case (BATCH_UNSOLVED):
+            return 1;
+         case (BATCH_NO_INPUT):
+            err_exit("Could not read batch path");
+         case (BATCH_NO_PUZZLE):
+            err_exit("No puzzle in batch path");
+         case (BATCH_NO_PATTERNS):
+            err_exit("Could not read deadlock pattern file");
+         case (BATCH_NO_THREAD):
+            err_exit("Could not start thread");
+         default:
+            err_exit("Memory Error");
+      }
+   }
+   
+   LevelFile input;
+   Solver *solver;
+   
+   if (open_levels(&input, STDIN_FILENO))
+      err_exit("Could not read puzzle");
+   if (init_solver(&solver, &options))
+      err_exit("Memory Error");
+   if ((pattern_file != NULL) && load_solver_patterns(solver, pattern_file))
+      err_exit("Could not read deadlock pattern file");
+   
+   int result = solve_puzzle(solver, input.data, input.length);
+   close_levels(&input);
+   if (result == SOLVER_INVALID)
+      err_exit((char *) solver_error(solver));
+   if (result == SOLVER_NO_MEMORY)
+      err_exit("Memory Error");
+   
+   if (result == SOLVER_SOLVED)
+      print_solution(solver);
+   if (solver_error(solver)[0] != 0)
+      fprintf(stderr, "%s\n", solver_error(solver));
+   if (options.stats)
+      print_solver_stats(solver, stderr, NULL);
+   
+   if ((pattern_file != NULL) && save_solver_patterns(solver, pattern_file))
+      fprintf(stderr, "Could not write deadlock pattern file %s\n", pattern_file);
+   
+   free_solver(solver);
+   return (result == SOLVER_SOLVED) ? 0 : 1;
+}
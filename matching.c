@@ -0,0 +1,170 @@
+/*
+ * matching.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "matching.h"
+
+#define COST(ptr, row, column) ((ptr)->cost[((row)-1) * (ptr)->size + ((column)-1)])
+
+/*
+ * finds a shortest augmenting path (in reduced costs) from the free row to a free column
+ * and flips it, adjusting the potentials so that every matched pair stays tight.
+ * requires u[i] + v[j] <= cost(i, j) for every row i, which holds for the rows already matched
+ * and has to be made to hold for the free row by the caller
+ */
+static void augment(Matching *ptr, u_int row) {
+   u_int n = ptr->size;
+   u_int column = 0;
+   
+   ptr->row_of[0] = row;
+   for (u_int j = 0; j <= n; j++) {
+      ptr->min_slack[j] = INT_MAX;
+      ptr->used[j] = 0;
+   }
+   
+   do {
+      ptr->used[column] = 1;
+      u_int i = ptr->row_of[column];
+      int delta = INT_MAX;
+      u_int next = 0;
+      
+      for (u_int j = 1; j <= n; j++) {
+         if (ptr->used[j])
+            continue;
+         int slack = COST(ptr, i, j) - ptr->u[i] - ptr->v[j];
+         if (slack < ptr->min_slack[j]) {
+            ptr->min_slack[j] = slack;
+            ptr->way[j] = column;
+         }
+         if (ptr->min_slack[j] < delta) {
+            delta = ptr->min_slack[j];
+            next = j;
+         }
+      }
+      
+      for (u_int j = 0; j <= n; j++) {
+         if (ptr->used[j]) {
+            ptr->u[ptr->row_of[j]] += delta;
+            ptr->v[j] -= delta;
+         } else
+            ptr->min_slack[j] -= delta;
+      }
+      column = next;
+   } while (ptr->row_of[column] != 0);
+   
+   // flip the path
+   do {
+      u_int previous = ptr->way[column];
+      ptr->row_of[column] = ptr->row_of[previous];
+      ptr->column_of[ptr->row_of[column]] = column;
+      column = previous;
+   } while (column != 0);
+}
+
+// lowers the potential of a free row until all its reduced costs are non negative
+static void fit_row(Matching *ptr, u_int row) {
+   int min = INT_MAX;
+   for (u_int j = 1; j <= ptr->size; j++)
+      if (COST(ptr, row, j) - ptr->v[j] < min)
+         min = COST(ptr, row, j) - ptr->v[j];
+   ptr->u[row] = min;
+}
+
+void set_row_matching(Matching *ptr, u_int row, int *costs) {
+   memcpy(ptr->cost + row * ptr->size, costs, sizeof(int) * ptr->size);
+   
+   row++;
+   if (ptr->column_of[row] != 0) {
+      ptr->row_of[ptr->column_of[row]] = 0;
+      ptr->column_of[row] = 0;
+      ptr->dirty++;
+   }
+}
+
+long solve_matching(Matching *ptr) {
+   u_int n = ptr->size;
+   
+   // repairing costs O(n^2) per row, past half the rows a fresh solve is as cheap
+   if (!ptr->solved || (ptr->dirty > n / 2)) {
+      for (u_int j = 0; j <= n; j++) {
+         ptr->u[j] = ptr->v[j] = 0;
+         ptr->row_of[j] = ptr->column_of[j] = 0;
+      }
+      for (u_int i = 1; i <= n; i++)
+         augment(ptr, i);
+      ptr->full_solves++;
+   } else {
+      for (u_int i = 1; i <= n; i++) {
+         if (ptr->column_of[i] != 0)
+            continue;
+         fit_row(ptr, i);
+         augment(ptr, i);
+         ptr->repaired_rows++;
+      }
+   }
+   ptr->solved = 1;
+   ptr->dirty = 0;
+   
+   long total = 0;
+   for (u_int i = 1; i <= n; i++)
+      total += COST(ptr, i, ptr->column_of[i]);
+   return total;
+}
+
+void free_matching(Matching *ptr) {
+   free(ptr->cost);
+   free(ptr->row_key);
+   free(ptr->u);
+   free(ptr->v);
+   free(ptr->row_of);
+   free(ptr->column_of);
+   free(ptr->min_slack);
+   free(ptr->way);
+   free(ptr->used);
+   free(ptr);
+}
+
+int init_matching(Matching **ptr, u_int size) {
+   *ptr = calloc(1, sizeof(Matching));
+   if (*ptr == NULL)
+      return 1;
+   
+   Matching *m = *ptr;
+   m->size = size;
+   m->cost = calloc((size_t) size * size + 1, sizeof(int));
+   m->row_key = malloc(sizeof(u_int) * (size + 1));
+   m->u = calloc(size + 1, sizeof(int));
+   m->v = calloc(size + 1, sizeof(int));
+   m->row_of = calloc(size + 1, sizeof(u_int));
+   m->column_of = calloc(size + 1, sizeof(u_int));
+   m->min_slack = malloc(sizeof(int) * (size + 1));
+   m->way = calloc(size + 1, sizeof(u_int));
+   m->used = malloc(sizeof(u_char) * (size + 1));
+   
+   if ((m->cost == NULL) || (m->row_key == NULL) || (m->u == NULL) || (m->v == NULL) ||
+      (m->row_of == NULL) || (m->column_of == NULL) || (m->min_slack == NULL) ||
+      (m->way == NULL) || (m->used == NULL)) {
+      free_matching(m);
+      return 1;
+   }
+   for (u_int i = 0; i <= size; i++)
+      m->row_key[i] = UINT_MAX;
+   return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef MATCHING_H
+#define MATCHING_H
+
+#include "types.h"
+
+// cost given to pairs that can never be matched, a total at or above it means no perfect matching exists
+#define MATCHING_NO_EDGE (1 << 20)
+
+/*
+ * minimum cost perfect matching between rows and columns of a square cost matrix (Hungarian algorithm).
+ * the assignment and the dual potentials are kept between calls, so when only a few rows change
+ * only those rows are unassigned and re-augmented, O(n^2) per changed row instead of O(n^3).
+ */
+typedef struct {
+   u_int size;
+   int *cost;              // cost[row*size + column]
+   u_int *row_key;         // free for the caller, to tell which rows changed since the last solve
+   
+   // 1-indexed as in the textbook formulation, index 0 is the dummy column of the augmentation
+   int *u;                 // row potentials
+   int *v;                 // column potentials
+   u_int *row_of;          // row assigned to each column, 0 if none
+   u_int *column_of;       // column assigned to each row, 0 if none
+   int *min_slack;
+   u_int *way;
+   u_char *used;
+   
+   _Bool solved;           // an assignment exists that can be repaired
+   u_int dirty;            // rows unassigned since the last solve
+   
+   unsigned long full_solves;
+   unsigned long repaired_rows;
+} Matching;
+
+int init_matching(Matching **ptr, u_int size);
+
+// replaces the costs of row and drops its assignment
+void set_row_matching(Matching *ptr, u_int row, int *costs);
+
+// returns the minimum total cost, repairing the rows changed since the last call
+long solve_matching(Matching *ptr);
+
+void free_matching(Matching *ptr);
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * pattern.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Deadlock patterns: the walls, goal positions and boxes of a small window of cells around a
+ * pushed box. A window is dead when its boxes can't all be brought to a goal position inside it
+ * or out of it, even with the rest of the level taken away. This is decided by a small search
+ * over the window surrounded by a ring of floor cells where:
+ *         a box pushed onto the ring is gone
+ *         the cursor starts in every region of the window at once
+ *         the ring is free to walk, so the cursor can go around the window
+ * Everything the real level adds can only get in the way, so a dead window is dead wherever it
+ * appears, in this level or in any other. A window is searched once and its verdict is kept,
+ * and the dead ones can be written to a file to be loaded by later runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pattern.h"
+
+// the window surrounded by its ring
+#define LOCAL_SIDE (PATTERN_SIDE + 2)
+#define LOCAL_CELLS (LOCAL_SIDE * LOCAL_SIDE)
+#define WINDOW_CELLS (PATTERN_SIDE * PATTERN_SIDE)
+#define SEEN_CAPACITY (2 * PATTERN_SEARCH_LIMIT)
+
+#define PATTERN_HEADER "sokoban patterns"
+
+// contents of a window cell, 3 bits of the key each
+enum { CELL_FLOOR, CELL_GOAL, CELL_WALL, CELL_BOX, CELL_BOX_GOAL };
+
+typedef struct {
+   u_char wall[LOCAL_CELLS];
+   u_int goals;            // window cells holding a goal position, bit i is window cell i
+} Window;
+
+// key used to look up a window in the table
+typedef struct {
+   Patterns *patterns;
+   uint64_t key;
+} PatternKey;
+
+int init_patterns(Patterns **ptr) {
+   *ptr = malloc(sizeof(Patterns));
+   if (*ptr == NULL)
+      return 1;
+   
+   Patterns *patterns = *ptr;
+   memset(patterns, 0, sizeof(Patterns));
+   patterns->capacity = 1024;
+   patterns->keys = malloc(sizeof(uint64_t) * patterns->capacity);
+   patterns->dead = malloc(sizeof(u_char) * patterns->capacity);
+   patterns->seen = malloc(sizeof(u_int) * SEEN_CAPACITY);
+   patterns->seen_stamp = calloc(SEEN_CAPACITY, sizeof(u_int));
+   patterns->queue = malloc(sizeof(u_int) * PATTERN_SEARCH_LIMIT);
+   
+   if ((patterns->keys == NULL) || (patterns->dead == NULL) || (patterns->seen == NULL) || (patterns->seen_stamp == NULL) ||
+      (patterns->queue == NULL) || init_table(&patterns->table, patterns->capacity))
+      return 1;
+   return 0;
+}
+
+void free_patterns(Patterns *ptr) {
+   if (ptr == NULL)
+      return;
+   free(ptr->keys);
+   free(ptr->dead);
+   free(ptr->seen);
+   free(ptr->seen_stamp);
+   free(ptr->queue);
+   if (ptr->table != NULL)
+      free_table(ptr->table);
+   free(ptr);
+}
+
+static uint64_t hash_key(uint64_t key) {
+   return next_random(&key);
+}
+
+static int equal_key(u_int index, void *key) {
+   PatternKey *pattern_key = key;
+   return pattern_key->patterns->keys[index] == pattern_key->key;
+}
+
+static u_int find_pattern(Patterns *patterns, uint64_t key) {
+   PatternKey pattern_key = { patterns, key };
+   return lookup_table(patterns->table, hash_key(key), &pattern_key, equal_key);
+}
+
+static int add_pattern(Patterns *patterns, uint64_t key, _Bool dead) {
+   if (patterns->length == patterns->capacity) {
+      u_int new_capacity = patterns->capacity * 2;
+      uint64_t *new_keys = realloc(patterns->keys, sizeof(uint64_t) * new_capacity);
+      if (new_keys == NULL)
+         return 1;
+      patterns->keys = new_keys;
+      u_char *new_dead = realloc(patterns->dead, sizeof(u_char) * new_capacity);
+      if (new_dead == NULL)
+         return 1;
+      patterns->dead = new_dead;
+      patterns->capacity = new_capacity;
+   }
+   
+   patterns->keys[patterns->length] = key;
+   patterns->dead[patterns->length] = dead;
+   return insert_table(patterns->table, hash_key(key), patterns->length++);
+}
+
+// cell of the local grid next to cell in direction mv, -1 past the ring
+static int local_neighbour(int cell, int mv) {
+   int row = cell / LOCAL_SIDE;
+   int column = cell % LOCAL_SIDE;
+   
+   switch (mv) {
+      case (0): row--; break;
+      case (1): row++; break;
+      case (2): column--; break;
+      case (3): column++; break;
+   }
+   if ((row < 0) || (row >= LOCAL_SIDE) || (column < 0) || (column >= LOCAL_SIDE))
+      return -1;
+   return row * LOCAL_SIDE + column;
+}
+
+static int local_cell(int window_cell) {
+   return (window_cell / PATTERN_SIDE + 1) * LOCAL_SIDE + window_cell % PATTERN_SIDE + 1;
+}
+
+// window cell of a local cell, -1 for the ring
+static int window_cell(int cell) {
+   int row = cell / LOCAL_SIDE - 1;
+   int column = cell % LOCAL_SIDE - 1;
+   
+   if ((row < 0) || (row >= PATTERN_SIDE) || (column < 0) || (column >= PATTERN_SIDE))
+      return -1;
+   return row * PATTERN_SIDE + column;
+}
+
+static _Bool occupied(Window *window, u_int boxes, int cell) {
+   int index = window_cell(cell);
+   return window->wall[cell] || ((index >= 0) && (boxes & (1U << index)));
+}
+
+// marks the region the cursor can walk to from start, returns its top-left cell
+static int flood_window(Window *window, u_int boxes, int start, u_char *marks) {
+   int stack[LOCAL_CELLS];
+   int length = 0;
+   int min_cell = start;
+   
+   marks[start] = 1;
+   stack[length++] = start;
+   while (length > 0) {
+      int cell = stack[--length];
+      if (cell < min_cell)
+         min_cell = cell;
+      
+      for (int mv = 0; mv < 4; mv++) {
+         int next = local_neighbour(cell, mv);
+         if ((next < 0) || marks[next] || occupied(window, boxes, next))
+            continue;
+         marks[next] = 1;
+         stack[length++] = next;
+      }
+   }
+   return min_cell;
+}
+
+// stacks the sub-search state unless it was seen already, returns 1 once the limit is hit
+static int add_window_state(Patterns *patterns, u_int *length, u_int *total, u_int boxes, int cursor) {
+   u_int key = (boxes << 6) | cursor;
+   u_int slot = (key * 2654435761U) & (SEEN_CAPACITY - 1);
+   
+   while (patterns->seen_stamp[slot] == patterns->stamp) {
+      if (patterns->seen[slot] == key)
+         return 0;
+      slot = (slot + 1) & (SEEN_CAPACITY - 1);
+   }
+   
+   if (*total == PATTERN_SEARCH_LIMIT)
+      return 1;
+   (*total)++;
+   patterns->seen[slot] = key;
+   patterns->seen_stamp[slot] = patterns->stamp;
+   patterns->queue[(*length)++] = key;
+   return 0;
+}
+
+/*
+ * DFS over the pushes inside the window, True only if no state with every box gone or on a goal is found.
+ * pushes taking a box out of the window are tried first, so that the usual alive window is
+ * settled after a handful of states, while a dead one has to be searched through anyway
+ */
+static _Bool prove_dead(Patterns *patterns, u_char *contents) {
+   Window window;
+   u_int boxes = 0;
+   
+   memset(&window, 0, sizeof(Window));
+   for (int i = 0; i < WINDOW_CELLS; i++) {
+      switch (contents[i]) {
+         case (CELL_WALL): window.wall[local_cell(i)] = 1; break;
+         case (CELL_GOAL): window.goals |= 1U << i; break;
+         case (CELL_BOX): boxes |= 1U << i; break;
+         case (CELL_BOX_GOAL): boxes |= 1U << i; window.goals |= 1U << i; break;
+      }
+   }
+   
+   // a new stamp empties the seen set
+   if (++patterns->stamp == 0) {
+      memset(patterns->seen_stamp, 0, sizeof(u_int) * SEEN_CAPACITY);
+      patterns->stamp = 1;
+   }
+   u_int length = 0, total = 0;
+   
+   // the cursor of the real state may be in any region of the window
+   u_char roots[LOCAL_CELLS] = { 0 };
+   for (int cell = 0; cell < LOCAL_CELLS; cell++) {
+      if (roots[cell] || occupied(&window, boxes, cell))
+         continue;
+      if (add_window_state(patterns, &length, &total, boxes, flood_window(&window, boxes, cell, roots)))
+         return False;
+   }
+   
+   int offsets[] = MOVE_OFFSETS(LOCAL_SIDE);
+   while (length > 0) {
+      u_int key = patterns->queue[--length];
+      boxes = key >> 6;
+      
+      if ((boxes & ~window.goals) == 0)
+         return False;
+      
+      u_char reach[LOCAL_CELLS] = { 0 };
+      flood_window(&window, boxes, key & 63, reach);
+      
+      // the pushes onto the ring are stacked last, so they are popped first
+      for (int exits = 0; exits < 2; exits++) {
+         for (int i = 0; i < WINDOW_CELLS; i++) {
+            if (!(boxes & (1U << i)))
+               continue;
+            
+            // window cells are never on the edge of the local grid, so all four neighbours exist
+            int cell = local_cell(i);
+            for (int mv = 0; mv < 4; mv++) {
+               int to = cell + offsets[mv];
+               if ((exits != (window_cell(to) < 0)) || !reach[cell - offsets[mv]] || occupied(&window, boxes, to))
+                  continue;
+               
+               u_int new_boxes = boxes & ~(1U << i);
+               if (!exits)
+                  new_boxes |= 1U << window_cell(to);
+               
+               u_char marks[LOCAL_CELLS] = { 0 };
+               if (add_window_state(patterns, &length, &total, new_boxes, flood_window(&window, new_boxes, cell, marks)))
+                  return False;
+            }
+         }
+      }
+   }
+   return True;
+}
+
+_Bool pattern_deadlock(Search *search, u_short *cells, u_int box_id) {
+   Level *level = search->level;
+   Patterns *patterns = search->patterns;
+   Coordinate box;
+   cell_coordinate(search, cells[box_id], &box);
+   
+   // the windows holding the box in one of their four middle cells
+   for (int x = box.x - PATTERN_SIDE/2; x < box.x; x++) {
+      for (int y = box.y - PATTERN_SIDE/2; y < box.y; y++) {
+         u_char contents[WINDOW_CELLS];
+         uint64_t key = 0;
+         _Bool off_goal = False;
+         u_int num_boxes = 0;
+         
+         for (int i = 0; i < WINDOW_CELLS; i++) {
+            int cell_x = x + i / PATTERN_SIDE;
+            int cell_y = y + i % PATTERN_SIDE;
+            
+            if ((cell_x < 0) || (cell_y < 0) || ((u_int) cell_x >= level->height) || ((u_int) cell_y >= level->width)) {
+               contents[i] = CELL_WALL;
+            } else {
+               u_int cell = cell_x * level->width + cell_y;
+               _Bool goal = (level->min_push_dist[cell] == 0); // goal positions are at distance 0
+               
+               if (level->walls[cell])
+                  contents[i] = CELL_WALL;
+               else if (search->box_map[cell])
+                  contents[i] = goal ? CELL_BOX_GOAL : CELL_BOX;
+               else
+                  contents[i] = goal ? CELL_GOAL : CELL_FLOOR;
+               off_goal |= (contents[i] == CELL_BOX);
+               num_boxes += (contents[i] == CELL_BOX) || (contents[i] == CELL_BOX_GOAL);
+            }
+            key |= (uint64_t) contents[i] << (3 * i);
+         }
+         
+         // nothing to prove when every box is on a goal position, and a lone box is up to the dead-square map
+         if (!off_goal || (num_boxes < 2))
+            continue;
+         
+         u_int index = find_pattern(patterns, key);
+         _Bool dead;
+         if (index != TABLE_EMPTY) {
+            dead = patterns->dead[index];
+         } else {
+            dead = prove_dead(patterns, contents);
+            patterns->searches++;
+            if (dead)
+               patterns->learned++;
+            add_pattern(patterns, key, dead);   // out of memory, the window is proven again next time
+         }
+         
+         if (dead) {
+            patterns->pruned++;
+            return True;
+         }
+      }
+   }
+   return False;
+}
+
+int load_patterns(Patterns *ptr, const char *filename) {
+   FILE *file = fopen(filename, "r");
+   if (file == NULL)
+      return 0;
+   
+   char line[64];
+   int side = 0;
+   if ((fgets(line, sizeof(line), file) == NULL) ||
+      (sscanf(line, PATTERN_HEADER " %d", &side) != 1) || (side != PATTERN_SIDE)) {
+      fclose(file);
+      return 1;
+   }
+   
+   while (fgets(line, sizeof(line), file) != NULL) {
+      uint64_t key = strtoull(line, NULL, 16);
+      if (find_pattern(ptr, key) != TABLE_EMPTY)
+         continue;
+      if (add_pattern(ptr, key, True)) {
+         fclose(file);
+         return 1;
+      }
+      ptr->loaded++;
+   }
+   
+   fclose(file);
+   return 0;
+}
+
+int merge_patterns(Patterns *ptr, Patterns *from) {
+   for (u_int i = 0; i < from->length; i++)
+      if (from->dead[i] && (find_pattern(ptr, from->keys[i]) == TABLE_EMPTY))
+         if (add_pattern(ptr, from->keys[i], True))
+            return 1;
+   return 0;
+}
+
+int save_patterns(Patterns *ptr, const char *filename) {
+   FILE *file = fopen(filename, "w");
+   if (file == NULL)
+      return 1;
+   
+   fprintf(file, PATTERN_HEADER " %d\n", PATTERN_SIDE);
+   for (u_int i = 0; i < ptr->length; i++)
+      if (ptr->dead[i])
+         fprintf(file, "%016" PRIx64 "\n", ptr->keys[i]);
+   
+   return fclose(file) != 0;
+}
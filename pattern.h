@@ -0,0 +1,49 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+#include "sokoban.h"
+
+// side of the square window of cells around a pushed box a pattern is made of
+#define PATTERN_SIDE 4
+// sub-searches visiting more states than this leave the window undecided, which counts as alive
+#define PATTERN_SEARCH_LIMIT 1024
+
+// every window met so far together with its verdict, the dead ones can be kept in a file between runs
+typedef struct patterns {
+   uint64_t *keys;         // window contents, 3 bits per cell
+   u_char *dead;
+   u_int length;
+   u_int capacity;
+   Table *table;           // keys by their hash, for lookup
+   
+   // scratch of the sub-search
+   u_int *seen;            // open addressing set of box mask << 6 | cursor cell
+   u_int *seen_stamp;      // a slot is in use when its stamp is the current one
+   u_int stamp;
+   u_int *queue;
+   
+   unsigned long searches;
+   unsigned long learned;
+   unsigned long loaded;
+   unsigned long pruned;
+} Patterns;
+
+int init_patterns(Patterns **ptr);
+
+// adds the dead windows stored in filename, a missing file is an empty database
+int load_patterns(Patterns *ptr, const char *filename);
+
+// adds the dead windows of from that ptr doesn't know yet
+int merge_patterns(Patterns *ptr, Patterns *from);
+
+// writes every dead window known, loaded or learned, to filename
+int save_patterns(Patterns *ptr, const char *filename);
+
+// whether a window around the box box_id just pushed to cells[box_id] is known or proven dead.
+// the boxes have to be marked in search->box_map
+_Bool pattern_deadlock(Search *search, u_short *cells, u_int box_id);
+
+void free_patterns(Patterns *ptr);
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ * pqueue.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "pqueue.h"
+
+#define PQ_HEAD (UINT_MAX - 1)   // prev value of the first item of a bucket list
+#define PQ_END (UINT_MAX - 1)    // next value of the last item of a bucket list
+
+static int grow_array(u_int **array, u_int old_size, u_int new_size, u_int fill) {
+   u_int *temp = realloc(*array, sizeof(u_int) * new_size);
+   if (temp == NULL)
+      return 1;
+   for (u_int i = old_size; i < new_size; i++)
+      temp[i] = fill;
+   *array = temp;
+   return 0;
+}
+
+static int grow_items(PQueue *ptr, u_int id) {
+   if (id < ptr->items_capacity)
+      return 0;
+   
+   u_int old_capacity = ptr->items_capacity;
+   u_int new_capacity = (old_capacity == 0) ? 1024 : old_capacity;
+   while (new_capacity <= id)
+      new_capacity *= 2;
+   
+   if (grow_array(&ptr->key, old_capacity, new_capacity, 0) ||
+      grow_array(&ptr->tie, old_capacity, new_capacity, 0))
+      return 1;
+   
+   if (ptr->kind == PQ_HEAP) {
+      if (grow_array(&ptr->pos, old_capacity, new_capacity, PQ_ABSENT) ||
+         grow_array(&ptr->order, old_capacity, new_capacity, 0))
+         return 1;
+   } else if (grow_array(&ptr->next, old_capacity, new_capacity, PQ_END) ||
+            grow_array(&ptr->prev, old_capacity, new_capacity, PQ_ABSENT))
+      return 1;
+   
+   ptr->items_capacity = new_capacity;
+   return 0;
+}
+
+static u_int tie_value(PQueue *ptr, u_int cost, u_int heuristic) {
+   switch (ptr->tie_break) {
+      case PQ_TIE_LOW_H: return heuristic;
+      case PQ_TIE_LOW_G: return cost;
+   }
+   return 0;
+}
+
+/* ---------------------------- binary heap ---------------------------- */
+
+// the newest of two items with the same key and tie comes first, like the head of a bucket list.
+// after 2^32 insertions the stamp wraps and the order of the ties is only approximately newest first
+static _Bool heap_less(PQueue *ptr, u_int a, u_int b) {
+   if (ptr->key[a] != ptr->key[b])
+      return ptr->key[a] < ptr->key[b];
+   if (ptr->tie[a] != ptr->tie[b])
+      return ptr->tie[a] < ptr->tie[b];
+   return ptr->order[a] > ptr->order[b];
+}
+
+static void heap_set(PQueue *ptr, u_int index, u_int id) {
+   ptr->heap[index] = id;
+   ptr->pos[id] = index;
+}
+
+static void sift_up(PQueue *ptr, u_int index) {
+   u_int id = ptr->heap[index];
+   while (index > 0) {
+      u_int parent = (index - 1) / 2;
+      if (!heap_less(ptr, id, ptr->heap[parent]))
+         break;
+      heap_set(ptr, index, ptr->heap[parent]);
+      index = parent;
+   }
+   heap_set(ptr, index, id);
+}
+
+static void sift_down(PQueue *ptr, u_int index) {
+   u_int id = ptr->heap[index];
+   for (;;) {
+      u_int child = 2 * index + 1;
+      if (child >= ptr->length)
+         break;
+      if ((child + 1 < ptr->length) && heap_less(ptr, ptr->heap[child + 1], ptr->heap[child]))
+         child++;
+      if (!heap_less(ptr, ptr->heap[child], id))
+         break;
+      heap_set(ptr, index, ptr->heap[child]);
+      index = child;
+   }
+   heap_set(ptr, index, id);
+}
+
+static int heap_insert(PQueue *ptr, u_int id) {
+   if (ptr->length == ptr->heap_capacity) {
+      u_int new_capacity = (ptr->heap_capacity == 0) ? 1024 : ptr->heap_capacity * 2;
+      if (grow_array(&ptr->heap, ptr->heap_capacity, new_capacity, 0))
+         return 1;
+      ptr->heap_capacity = new_capacity;
+   }
+   ptr->heap[ptr->length] = id;
+   ptr->length++;
+   sift_up(ptr, ptr->length - 1);
+   return 0;
+}
+
+static u_int heap_remove_min(PQueue *ptr) {
+   u_int id = ptr->heap[0];
+   ptr->pos[id] = PQ_ABSENT;
+   ptr->length--;
+   if (ptr->length > 0) {
+      ptr->heap[0] = ptr->heap[ptr->length];
+      sift_down(ptr, 0);
+   }
+   return id;
+}
+
+/* ------------------------------ buckets ------------------------------ */
+
+static int bucket_reserve(PQueue *ptr, u_int key, u_int tie) {
+   if (key >= ptr->num_buckets) {
+      u_int new_size = (ptr->num_buckets == 0) ? 64 : ptr->num_buckets;
+      while (new_size <= key)
+         new_size *= 2;
+      
+      u_int **buckets = realloc(ptr->buckets, sizeof(u_int *) * new_size);
+      if (buckets == NULL)
+         return 1;
+      memset(buckets + ptr->num_buckets, 0, sizeof(u_int *) * (new_size - ptr->num_buckets));
+      ptr->buckets = buckets;
+      
+      if (grow_array(&ptr->bucket_ties, ptr->num_buckets, new_size, 0) ||
+         grow_array(&ptr->bucket_length, ptr->num_buckets, new_size, 0) ||
+         grow_array(&ptr->bucket_min_tie, ptr->num_buckets, new_size, PQ_ABSENT))
+         return 1;
+      ptr->num_buckets = new_size;
+   }
+   
+   if (tie >= ptr->bucket_ties[key]) {
+      u_int new_size = (ptr->bucket_ties[key] == 0) ? 16 : ptr->bucket_ties[key];
+      while (new_size <= tie)
+         new_size *= 2;
+      if (grow_array(&ptr->buckets[key], ptr->bucket_ties[key], new_size, PQ_END))
+         return 1;
+      ptr->bucket_ties[key] = new_size;
+   }
+   return 0;
+}
+
+static int bucket_link(PQueue *ptr, u_int id) {
+   u_int key = ptr->key[id];
+   u_int tie = ptr->tie[id];
+   if (bucket_reserve(ptr, key, tie))
+      return 1;
+   
+   // new items go to the front, so items of equal priority come out last in first out
+   u_int head = ptr->buckets[key][tie];
+   ptr->next[id] = head;
+   ptr->prev[id] = PQ_HEAD;
+   if (head != PQ_END)
+      ptr->prev[head] = id;
+   ptr->buckets[key][tie] = id;
+   
+   ptr->bucket_length[key]++;
+   if (tie < ptr->bucket_min_tie[key])
+      ptr->bucket_min_tie[key] = tie;
+   if (key < ptr->min_key)
+      ptr->min_key = key;
+   ptr->length++;
+   return 0;
+}
+
+static void bucket_unlink(PQueue *ptr, u_int id) {
+   u_int key = ptr->key[id];
+   u_int tie = ptr->tie[id];
+   
+   if (ptr->prev[id] == PQ_HEAD)
+      ptr->buckets[key][tie] = ptr->next[id];
+   else
+      ptr->next[ptr->prev[id]] = ptr->next[id];
+   if (ptr->next[id] != PQ_END)
+      ptr->prev[ptr->next[id]] = ptr->prev[id];
+   
+   ptr->prev[id] = PQ_ABSENT;
+   ptr->bucket_length[key]--;
+   ptr->length--;
+}
+
+static u_int bucket_remove_min(PQueue *ptr) {
+   while (ptr->bucket_length[ptr->min_key] == 0)
+      ptr->min_key++;
+   
+   u_int key = ptr->min_key;
+   u_int tie = ptr->bucket_min_tie[key];
+   while (ptr->buckets[key][tie] == PQ_END)
+      tie++;
+   ptr->bucket_min_tie[key] = tie;
+   
+   u_int id = ptr->buckets[key][tie];
+   bucket_unlink(ptr, id);
+   return id;
+}
+
+/* ------------------------------ common ------------------------------- */
+
+int insert_pqueue(PQueue *ptr, u_int id, u_int cost, u_int heuristic) {
+   if (id >= PQ_END)
+      return 1;
+   if (grow_items(ptr, id))
+      return 1;
+   
+   ptr->key[id] = cost + heuristic;
+   ptr->tie[id] = tie_value(ptr, cost, heuristic);
+   
+   if (ptr->kind == PQ_HEAP) {
+      ptr->order[id] = ptr->stamp++;
+      return heap_insert(ptr, id);
+   }
+   return bucket_link(ptr, id);
+}
+
+int update_pqueue(PQueue *ptr, u_int id, u_int cost, u_int heuristic) {
+   if (!contains_pqueue(ptr, id))
+      return 1;
+   
+   u_int old_key = ptr->key[id];
+   u_int old_tie = ptr->tie[id];
+   
+   if (ptr->kind == PQ_HEAP) {
+      ptr->key[id] = cost + heuristic;
+      ptr->tie[id] = tie_value(ptr, cost, heuristic);
+      ptr->order[id] = ptr->stamp++;
+      if ((ptr->key[id] < old_key) || ((ptr->key[id] == old_key) && (ptr->tie[id] <= old_tie)))
+         sift_up(ptr, ptr->pos[id]);
+      else
+         sift_down(ptr, ptr->pos[id]);
+      return 0;
+   }
+   
+   bucket_unlink(ptr, id);
+   ptr->key[id] = cost + heuristic;
+   ptr->tie[id] = tie_value(ptr, cost, heuristic);
+   return bucket_link(ptr, id);
+}
+
+_Bool contains_pqueue(PQueue *ptr, u_int id) {
+   if (id >= ptr->items_capacity)
+      return 0;
+   if (ptr->kind == PQ_HEAP)
+      return ptr->pos[id] != PQ_ABSENT;
+   return ptr->prev[id] != PQ_ABSENT;
+}
+
+u_int remove_min_pqueue(PQueue *ptr) {
+   if (ptr->length == 0)
+      return PQ_ABSENT;
+   
+   return (ptr->kind == PQ_HEAP) ? heap_remove_min(ptr) : bucket_remove_min(ptr);
+}
+
+u_int min_key_pqueue(PQueue *ptr) {
+   if (ptr->length == 0)
+      return PQ_ABSENT;
+   if (ptr->kind == PQ_HEAP)
+      return ptr->key[ptr->heap[0]];
+   
+   while (ptr->bucket_length[ptr->min_key] == 0)
+      ptr->min_key++;
+   return ptr->min_key;
+}
+
+void clear_pqueue(PQueue *ptr) {
+   if (ptr->kind == PQ_HEAP) {
+      for (u_int i = 0; i < ptr->length; i++)
+         ptr->pos[ptr->heap[i]] = PQ_ABSENT;
+   } else {
+      for (u_int key = 0; key < ptr->num_buckets; key++) {
+         if (ptr->bucket_length[key] == 0)
+            continue;
+         for (u_int tie = 0; tie < ptr->bucket_ties[key]; tie++) {
+            for (u_int id = ptr->buckets[key][tie]; id != PQ_END; id = ptr->next[id])
+               ptr->prev[id] = PQ_ABSENT;
+            ptr->buckets[key][tie] = PQ_END;
+         }
+         ptr->bucket_length[key] = 0;
+         ptr->bucket_min_tie[key] = PQ_ABSENT;
+      }
+   }
+   ptr->length = 0;
+   ptr->stamp = 0;
+   ptr->min_key = UINT_MAX;
+}
+
+size_t size_pqueue(PQueue *ptr) {
+   size_t size = sizeof(PQueue) + sizeof(u_int) * ((size_t) ptr->items_capacity * 4 + ptr->heap_capacity);
+   for (u_int i = 0; i < ptr->num_buckets; i++)
+      size += sizeof(u_int *) + sizeof(u_int) * (3 + (size_t) ptr->bucket_ties[i]);
+   return size;
+}
+
+void free_pqueue(PQueue *ptr) {
+   for (u_int i = 0; i < ptr->num_buckets; i++)
+      free(ptr->buckets[i]);
+   free(ptr->buckets);
+   free(ptr->bucket_ties);
+   free(ptr->bucket_length);
+   free(ptr->bucket_min_tie);
+   free(ptr->heap);
+   free(ptr->key);
+   free(ptr->tie);
+   free(ptr->pos);
+   free(ptr->order);
+   free(ptr->next);
+   free(ptr->prev);
+   free(ptr);
+}
+
+int init_pqueue(PQueue **ptr, u_char kind, u_char tie_break) {
+   *ptr = calloc(1, sizeof(PQueue));
+   if (*ptr == NULL)
+      return 1;
+   
+   (*ptr)->kind = kind;
+   (*ptr)->tie_break = tie_break;
+   (*ptr)->min_key = UINT_MAX;
+   return 0;
+}
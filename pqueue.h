@@ -0,0 +1,73 @@
+#ifndef PQUEUE_H
+#define PQUEUE_H
+
+#include <stddef.h>
+#include <limits.h>
+#include "types.h"
+
+// frontier implementations
+#define PQ_BUCKET 0    // array of buckets indexed by f, O(1) insert and amortised O(1) removal
+#define PQ_HEAP 1      // binary heap, O(log n) insert and removal
+
+// tie breaking between items with the same f = cost + heuristic
+#define PQ_TIE_LOW_H 0   // prefer the item closest to the goal (deepest)
+#define PQ_TIE_LOW_G 1   // prefer the item closest to the root
+#define PQ_TIE_NONE 2    // no preference, last in first out
+
+// whatever the tie break, items with the same f and tie value come out last in first out
+
+#define PQ_ABSENT UINT_MAX
+
+// items are identified by a caller-chosen id (small and dense, it indexes the internal arrays)
+// so that their priority can be changed without searching for them. only ids are stored,
+// the items themselves live elsewhere
+typedef struct {
+   u_char kind;
+   u_char tie_break;
+   u_int length;
+   
+   // per item data, indexed by item id
+   u_int *key;
+   u_int *tie;
+   u_int *pos;            // heap: index in the heap, PQ_ABSENT if not in the queue
+   u_int *order;          // heap: value of stamp when the item was inserted or updated
+   u_int *next;           // buckets: doubly linked list per bucket, prev is PQ_ABSENT if not in the queue
+   u_int *prev;
+   u_int items_capacity;
+   
+   u_int *heap;
+   u_int heap_capacity;
+   u_int stamp;           // heap: insertions and updates so far, the buckets keep their order in their lists
+   
+   u_int **buckets;       // buckets[key][tie] is the head of a list linked through next/prev
+   u_int *bucket_ties;    // number of tie slots allocated per bucket
+   u_int *bucket_length;
+   u_int *bucket_min_tie;
+   u_int num_buckets;
+   u_int min_key;
+} PQueue;
+
+int init_pqueue(PQueue **ptr, u_char kind, u_char tie_break);
+
+int insert_pqueue(PQueue *ptr, u_int id, u_int cost, u_int heuristic);
+
+// change the priority of an item already in the queue (decrease-key)
+int update_pqueue(PQueue *ptr, u_int id, u_int cost, u_int heuristic);
+
+_Bool contains_pqueue(PQueue *ptr, u_int id);
+
+// returns the id of the item with the lowest priority, PQ_ABSENT if the queue is empty
+u_int remove_min_pqueue(PQueue *ptr);
+
+// f of the item remove_min_pqueue would return, PQ_ABSENT if the queue is empty
+u_int min_key_pqueue(PQueue *ptr);
+
+// removes every item, keeping the arrays grown so far
+void clear_pqueue(PQueue *ptr);
+
+// total bytes held by the queue
+size_t size_pqueue(PQueue *ptr);
+
+void free_pqueue(PQueue *ptr);
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * push.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Push mode: instead of one node per cursor step, a node is a box configuration together with
+ * the region the cursor can walk to without pushing anything. The region is represented by
+ * its top-left cell (lowest cell index), so every cursor position inside it maps to the same state.
+ * The children of a node are all the pushes possible from anywhere in its region, and the cost
+ * of a node is its number of pushes, so the solutions found are push optimal.
+ * The walking in between pushes is filled in with a BFS when the solution is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "push.h"
+#include "deadlock.h"
+#include "pattern.h"
+#include "corral.h"
+#include "macro.h"
+
+int init_push(Search *search) {
+   u_int num_cells = search->level->num_cells;
+   
+   search->reach = calloc(num_cells, sizeof(u_int));
+   search->visited = calloc(num_cells, sizeof(u_int));
+   search->cell_queue = malloc(sizeof(u_short) * num_cells);
+   search->came_from = malloc(sizeof(u_char) * num_cells);
+   search->stamp = 0;
+   
+   if ((search->reach == NULL) || (search->visited == NULL) ||
+      (search->cell_queue == NULL) || (search->came_from == NULL))
+      return 1;
+   return 0;
+}
+
+void free_push(Search *search) {
+   free(search->reach);
+   free(search->visited);
+   free(search->cell_queue);
+   free(search->came_from);
+}
+
+// a fresh stamp value marks a cell as visited without clearing the marks of the previous fill
+static u_int next_stamp(Search *search) {
+   if (search->stamp == UINT_MAX) {
+      u_int num_cells = search->level->num_cells;
+      memset(search->reach, 0, sizeof(u_int) * num_cells);
+      memset(search->visited, 0, sizeof(u_int) * num_cells);
+      search->stamp = 0;
+   }
+   return ++search->stamp;
+}
+
+// marks with stamp every cell the cursor can walk to from start, the boxes in box_map are in the way.
+// returns the top-left cell of the region
+static u_short flood_region(Search *search, u_short start, u_int *marks, u_int stamp) {
+   int *offsets = search->level->offsets;
+   u_short *queue = search->cell_queue;
+   u_int head = 0, tail = 0;
+   u_short min_cell = start;
+   
+   queue[tail++] = start;
+   marks[start] = stamp;
+   while (head < tail) {
+      u_short cell = queue[head++];
+      if (cell < min_cell)
+         min_cell = cell;
+      
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + offsets[mv];
+         if (search->level->walls[next] || search->box_map[next] || (marks[next] == stamp))
+            continue;
+         marks[next] = stamp;
+         queue[tail++] = next;
+      }
+   }
+   return min_cell;
+}
+
+u_short normalize_cursor(Search *search, u_short cursor, u_short *cells) {
+   for (u_int i = 0; i < search->level->num_boxes; i++)
+      search->box_map[cells[i]] = i+1;
+   
+   u_short normalized = flood_region(search, cursor, search->visited, next_stamp(search));
+   
+   for (u_int i = 0; i < search->level->num_boxes; i++)
+      search->box_map[cells[i]] = 0;
+   return normalized;
+}
+
+/*
+ * Given one state this function makes a child for every box that can be pushed in every direction
+ * from the region of the cursor. A push into a tunnel or onto the entrance of a goal room goes on
+ * within the same child when macros are on (see macro.c). A child is not inserted if:
+ *         the push is not one of the pushes of a PI-corral while there is one (see corral.c)
+ *         the box is pushed on a dead square (see level.c)
+ *         the push freezes boxes off their goal positions (see deadlock.c)
+ *         the box ends up in a window of boxes proven dead (see pattern.c)
+ *         is found in the state table (see add_child function)
+ */
+int make_push(Search *search, u_int state_id) {
+   u_int num_boxes = search->level->num_boxes;
+   int *offsets = search->level->offsets;
+   
+   State *current_state = get_state(search, state_id);
+   STATS_EXPAND(search);
+   
+   Coordinate cur_pos;
+   Coordinate boxes[num_boxes];
+   u_short cells[num_boxes];
+   unpack_state(search, current_state, &cur_pos, boxes);
+   memcpy(cells, current_state->boxes, sizeof(u_short) * num_boxes);
+   
+   // hash of the boxes alone, the cursor key of each child is added to it
+   uint64_t hash = hash_state(&search->zobrist, &cur_pos, boxes, num_boxes) ^
+                     search->zobrist.cursor[current_state->current_pos];
+   prepare_heuristic(search, state_id, boxes);
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = i+1;
+   
+   u_int reach_stamp = next_stamp(search);
+   flood_region(search, current_state->current_pos, search->reach, reach_stamp);
+   _Bool pi_corral = (search->corral != NULL) && find_pi_corral(search, cells, reach_stamp);
+   
+   for (u_int box_id = 0; box_id < num_boxes; box_id++) {
+      for (int mv = 0; mv < 4; mv++) {
+         u_short from = cells[box_id];
+         u_short to = from + offsets[mv];
+         
+         // the cursor has to get behind the box, and the box needs space to move
+         if ((search->reach[from - offsets[mv]] != reach_stamp) || search->level->walls[to] || search->box_map[to])
+            continue;
+         if (pi_corral && !(search->corral->pushes[box_id] & (1 << mv))) {
+            search->corral->pruned++;
+            STATS_ADD(search, corral_pruned);
+            continue;
+         }
+         
+         cells[box_id] = to;
+         search->box_map[from] = 0;
+         search->box_map[to] = box_id+1;
+         
+         // after the push the cursor stands where the box was, unless a macro pushed it further
+         u_short behind = from;
+         u_int pushes = 1;
+         if ((search->macros != NULL) && !search->level->dead[to])
+            pushes += extend_push(search, cells, box_id, mv, &behind);
+         to = cells[box_id];
+         cell_coordinate(search, to, &boxes[box_id]);
+         
+         STATS_ADD(search, generated);
+         uint64_t started = STATS_START(search);
+         _Bool deadlock = search->level->dead[to] || freeze_deadlock(search, cells, box_id) ||
+                           pattern_deadlock(search, cells, box_id);
+         STATS_STOP(search, deadlock_ticks, started);
+         
+         if (deadlock)
+            STATS_ADD(search, deadlock_pruned);
+         else {
+            u_short new_cursor = flood_region(search, behind, search->visited, next_stamp(search));
+            uint64_t new_hash = hash ^ search->zobrist.cursor[new_cursor] ^
+                                 search->zobrist.boxes[from] ^ search->zobrist.boxes[to];
+            
+            search->cache.moved_box = box_id;
+            if (add_child(search, state_id, mv, pushes, new_hash, new_cursor, cells, NULL, boxes))
+               return 1;
+         }
+         
+         // revert changes in box
+         cells[box_id] = from;
+         cell_coordinate(search, from, &boxes[box_id]);
+         search->box_map[to] = 0;
+         search->box_map[from] = box_id+1;
+      }
+   }
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = 0;
+   search->cache.state = NO_STATE;
+   
+   return 0;
+}
+
+/*
+ * Given one state of the backward search (see bidir.c) this function makes a child for every pull
+ * possible from the region of the cursor: the cursor stands next to a box, steps away from it
+ * and drags it along. move_from_parent holds the push that undoes the pull, so that a backward
+ * path read from child to parent is a sequence of forward pushes.
+ * Pulls from a solvable state always lead to a solvable state, so no deadlock checks are made
+ */
+int make_pull(Search *search, u_int state_id) {
+   u_int num_boxes = search->level->num_boxes;
+   int *offsets = search->level->offsets;
+   
+   State *current_state = get_state(search, state_id);
+   STATS_EXPAND(search);
+   
+   Coordinate cur_pos;
+   Coordinate boxes[num_boxes];
+   u_short cells[num_boxes];
+   unpack_state(search, current_state, &cur_pos, boxes);
+   memcpy(cells, current_state->boxes, sizeof(u_short) * num_boxes);
+   
+   uint64_t hash = hash_state(&search->zobrist, &cur_pos, boxes, num_boxes) ^
+                     search->zobrist.cursor[current_state->current_pos];
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = i+1;
+   
+   u_int reach_stamp = next_stamp(search);
+   flood_region(search, current_state->current_pos, search->reach, reach_stamp);
+   
+   for (u_int box_id = 0; box_id < num_boxes; box_id++) {
+      for (int mv = 0; mv < 4; mv++) {
+         u_short from = cells[box_id];
+         u_short to = from + offsets[mv];        // where the cursor stands, and the box ends up
+         u_short step = to + offsets[mv];        // where the cursor steps to
+         
+         if ((search->reach[to] != reach_stamp) || search->level->walls[step] || search->box_map[step])
+            continue;
+         
+         cells[box_id] = to;
+         cell_coordinate(search, to, &boxes[box_id]);
+         search->box_map[from] = 0;
+         search->box_map[to] = box_id+1;
+         
+         u_short new_cursor = flood_region(search, step, search->visited, next_stamp(search));
+         uint64_t new_hash = hash ^ search->zobrist.cursor[new_cursor] ^
+                              search->zobrist.boxes[from] ^ search->zobrist.boxes[to];
+         
+         // moves come in opposite pairs (up, down), (left, right)
+         STATS_ADD(search, generated);
+         if (add_child(search, state_id, mv ^ 1, 1, new_hash, new_cursor, cells, NULL, boxes))
+            return 1;
+         
+         // revert changes in box
+         cells[box_id] = from;
+         cell_coordinate(search, from, &boxes[box_id]);
+         search->box_map[to] = 0;
+         search->box_map[from] = box_id+1;
+      }
+   }
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = 0;
+   
+   return 0;
+}
+
+// the top-left cells of all the regions next to the boxes in cells, written to regions.
+// these are all the regions the cursor can be in after pushing one of them. returns their number
+u_int cursor_regions(Search *search, u_short *cells, u_short *regions) {
+   int *offsets = search->level->offsets;
+   u_int num_boxes = search->level->num_boxes;
+   u_int stamp = next_stamp(search);
+   u_int count = 0;
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = i+1;
+   
+   for (u_int i = 0; i < num_boxes; i++) {
+      for (int mv = 0; mv < 4; mv++) {
+         u_short cell = cells[i] + offsets[mv];
+         if (search->level->walls[cell] || search->box_map[cell] || (search->reach[cell] == stamp))
+            continue;
+         regions[count++] = flood_region(search, cell, search->reach, stamp);
+      }
+   }
+   
+   for (u_int i = 0; i < num_boxes; i++)
+      search->box_map[cells[i]] = 0;
+   return count;
+}
+
+typedef struct {
+   char *str;
+   size_t length;
+   size_t capacity;
+} Buffer;
+
+static int append_move(Buffer *buffer, u_char move) {
+   const char *name = move_name(move);
+   size_t needed = buffer->length + strlen(name) + 2;
+   
+   if (needed > buffer->capacity) {
+      size_t new_capacity = (buffer->capacity == 0) ? 256 : buffer->capacity * 2;
+      while (new_capacity < needed)
+         new_capacity *= 2;
+      char *temp = realloc(buffer->str, new_capacity);
+      if (temp == NULL)
+         return 1;
+      buffer->str = temp;
+      buffer->capacity = new_capacity;
+   }
+   
+   if (buffer->length > 0)
+      buffer->str[buffer->length++] = ' ';
+   strcpy(buffer->str + buffer->length, name);
+   buffer->length += strlen(name);
+   return 0;
+}
+
+// BFS from start to target around the boxes in box_map, the moves are appended to buffer
+static int walk_path(Search *search, u_short start, u_short target, Buffer *buffer) {
+   int *offsets = search->level->offsets;
+   u_short *queue = search->cell_queue;
+   u_int stamp = next_stamp(search);
+   u_int head = 0, tail = 0;
+   
+   queue[tail++] = start;
+   search->visited[start] = stamp;
+   while ((head < tail) && (search->visited[target] != stamp)) {
+      u_short cell = queue[head++];
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + offsets[mv];
+         if (search->level->walls[next] || search->box_map[next] || (search->visited[next] == stamp))
+            continue;
+         search->visited[next] = stamp;
+         search->came_from[next] = mv;
+         queue[tail++] = next;
+      }
+   }
+   if (search->visited[target] != stamp)
+      return 1;
+   
+   // walk back from the target, the queue is free to hold the moves in reverse
+   u_int length = 0;
+   for (u_short cell = target; cell != start; cell -= offsets[search->came_from[cell]])
+      queue[length++] = search->came_from[cell];
+   
+   while (length > 0)
+      if (append_move(buffer, queue[--length]))
+         return 1;
+   return 0;
+}
+
+/*
+ * fewest pushes getting the box on from to to around the other boxes in box_map, for the children made
+ * by a macro (see macro.c). the walks and pushes are appended to buffer, cursor starts where it stands
+ * and is left behind the box
+ */
+static int push_box(Search *search, u_short *cursor, u_short from, u_short to, Buffer *buffer) {
+   int *offsets = search->level->offsets;
+   u_int num_nodes = search->level->num_cells * 4;
+   
+   // a node is the cell of the box times 4 plus the push that got it there, num_nodes stands for from
+   u_int *prev = malloc(sizeof(u_int) * num_nodes);
+   u_int *queue = malloc(sizeof(u_int) * num_nodes);
+   if ((prev == NULL) || (queue == NULL)) {
+      free(prev);
+      free(queue);
+      return 1;
+   }
+   for (u_int i = 0; i < num_nodes; i++)
+      prev[i] = UINT_MAX;
+   
+   u_int head = 0, tail = 0, found = UINT_MAX;
+   search->box_map[from] = 0;
+   queue[tail++] = num_nodes;
+   while ((head < tail) && (found == UINT_MAX)) {
+      u_int node = queue[head++];
+      u_short box = (node == num_nodes) ? from : node / 4;
+      u_short player = (node == num_nodes) ? *cursor : box - offsets[node % 4];
+      
+      search->box_map[box] = 1;
+      u_int stamp = next_stamp(search);
+      flood_region(search, player, search->reach, stamp);
+      search->box_map[box] = 0;
+      
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = box + offsets[mv];
+         u_int child = next * 4 + mv;
+         if ((search->reach[box - offsets[mv]] != stamp) || search->level->walls[next] ||
+            search->box_map[next] || (prev[child] != UINT_MAX))
+            continue;
+         prev[child] = node;
+         queue[tail++] = child;
+         if (next == to) {
+            found = child;
+            break;
+         }
+      }
+   }
+   
+   // the pushes in reverse, then walked and made in order
+   u_int length = 0;
+   for (u_int node = found; (found != UINT_MAX) && (node != num_nodes); node = prev[node])
+      queue[length++] = node;
+   
+   int failed = (found == UINT_MAX);
+   u_short box = from;
+   while (!failed && (length > 0)) {
+      u_int node = queue[--length];
+      search->box_map[box] = 1;
+      failed = walk_path(search, *cursor, box - offsets[node % 4], buffer) || append_move(buffer, node % 4);
+      search->box_map[box] = 0;
+      *cursor = box;
+      box = node / 4;
+   }
+   search->box_map[from] = 1;
+   
+   free(prev);
+   free(queue);
+   return failed;
+}
+
+char *push_solution(Search *search, u_int sol) {
+   u_int num_boxes = search->level->num_boxes;
+   int *offsets = search->level->offsets;
+   Buffer buffer = { NULL, 0, 0 };
+   
+   u_int depth = 0;
+   for (u_int id = sol; id != NO_STATE; id = get_state(search, id)->parent)
+      depth++;
+   
+   u_int *path = malloc(sizeof(u_int) * depth);
+   if (path == NULL)
+      return NULL;
+   u_int i = depth;
+   for (u_int id = sol; id != NO_STATE; id = get_state(search, id)->parent)
+      path[--i] = id;
+   
+   u_short cursor = search->start;
+   for (i = 1; i < depth; i++) {
+      State *parent = get_state(search, path[i-1]);
+      State *child = get_state(search, path[i]);
+      
+      for (u_int b = 0; b < num_boxes; b++)
+         search->box_map[child->boxes[b]] = 1;
+      
+      // the pushed box is the one the child no longer has, box order may differ between
+      // the two if the child was reached through another path first
+      u_short from = 0;
+      for (u_int b = 0; b < num_boxes; b++)
+         if (!search->box_map[parent->boxes[b]]) 
+            from = parent->boxes[b];
+      
+      for (u_int b = 0; b < num_boxes; b++)
+         search->box_map[child->boxes[b]] = 0;
+      for (u_int b = 0; b < num_boxes; b++)
+         search->box_map[parent->boxes[b]] = 1;
+      
+      // and it went to the cell the parent doesn't have
+      u_short to = 0;
+      for (u_int b = 0; b < num_boxes; b++)
+         if (!search->box_map[child->boxes[b]])
+            to = child->boxes[b];
+      
+      u_char move = child->move_from_parent & MOVE_MASK;
+      int failed;
+      if (to == from + offsets[move]) {
+         failed = walk_path(search, cursor, from - offsets[move], &buffer) || append_move(&buffer, move);
+         cursor = from;
+      }
+      else
+         failed = push_box(search, &cursor, from, to, &buffer);
+      
+      for (u_int b = 0; b < num_boxes; b++)
+         search->box_map[parent->boxes[b]] = 0;
+      
+      if (failed) {
+         free(buffer.str);
+         free(path);
+         return NULL;
+      }
+   }
+   
+   free(path);
+   if (buffer.str == NULL)
+      buffer.str = calloc(1, sizeof(char));
+   return buffer.str;
+}
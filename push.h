@@ -0,0 +1,24 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#include "sokoban.h"
+
+int init_push(Search *search);
+
+void free_push(Search *search);
+
+// cell standing for the region the cursor can walk to from cursor, boxes are given as cells
+u_short normalize_cursor(Search *search, u_short cursor, u_short *cells);
+
+int make_push(Search *search, u_int state_id);
+
+// the pulls of the backward search, the reverse of make_push (see bidir.c)
+int make_pull(Search *search, u_int state_id);
+
+// top-left cells of every region next to the boxes in cells, returns their number
+u_int cursor_regions(Search *search, u_short *cells, u_short *regions);
+
+// full move sequence of a push mode solution, separated by spaces. the caller frees it
+char *push_solution(Search *search, u_int sol);
+
+#endif
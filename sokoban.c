@@ -15,45 +15,97 @@
  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L  // clock_gettime
+
 #include <stdio.h>
 #include <stdlib.h>
-#include "queue.h"
+#include <time.h>
+#include <unistd.h>
+#include "sokoban.h"
+#include "push.h"
+#include "deadlock.h"
+#include "pattern.h"
+#include "hda.h"
+#include "ida.h"
+#include "bidir.h"
+#include "spill.h"
+#include "ara.h"
+#include "beam.h"
+#include "symmetry.h"
+#include "corral.h"
+#include "macro.h"
 #include <math.h>
 #include <string.h>
 #include <limits.h>
 
-#define True 1
-#define False 0
-
-#define PUZZLE_WIDTH_LIMIT 200
 #define OPTIMALITY_STRICTNESS 1  // 1 is for optimal, higher values sacrifice optimality for speed and memory
 
-typedef struct {
-   int x;
-   int y;
-} Coordinate;
+// splitmix64, a fixed seed is used so that runs are reproducible
+uint64_t next_random(uint64_t *seed) {
+   uint64_t z = (*seed += 0x9E3779B97F4A7C15ULL);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+double now_seconds(void) {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + now.tv_nsec * 1e-9;
+}
 
-// Lightweight state, only boxes coordinates and cursor coordinates are stored
-typedef struct state {
-   u_char move_from_parent;
-   struct state *parent;
-   Coordinate *current_pos;
-   Coordinate *boxes;
-   int cost_score;
-   u_int heuristic_score;
-} State;
+void free_zobrist(Zobrist *zobrist) {
+   free(zobrist->boxes);
+   free(zobrist->cursor);
+}
+
+int init_zobrist(Zobrist *zobrist, u_int height, u_int width) {
+   uint64_t seed = 0x536F6B6F62616EULL;
+   
+   zobrist->width = width;
+   zobrist->boxes = malloc(sizeof(uint64_t) * height * width);
+   zobrist->cursor = malloc(sizeof(uint64_t) * height * width);
+   if ((zobrist->boxes == NULL) || (zobrist->cursor == NULL))
+      return 1;
    
-void err_exit(char *msg) {
-   fprintf(stderr, "%s\n", msg);
-   exit(1);
+   for (u_int i = 0; i < height * width; i++) {
+      zobrist->boxes[i] = next_random(&seed);
+      zobrist->cursor[i] = next_random(&seed);
+   }
+   return 0;
+}
+
+uint64_t zobrist_box(Zobrist *zobrist, int x, int y) {
+   return zobrist->boxes[x * zobrist->width + y];
+}
+
+uint64_t zobrist_cursor(Zobrist *zobrist, int x, int y) {
+   return zobrist->cursor[x * zobrist->width + y];
+}
+
+uint64_t hash_state(Zobrist *zobrist, Coordinate *cursor, Coordinate *boxes, u_int num_boxes) {
+   uint64_t hash = zobrist_cursor(zobrist, cursor->x, cursor->y);
+   for (u_int i = 0; i < num_boxes; i++)
+      hash ^= zobrist_box(zobrist, boxes[i].x, boxes[i].y);
+   return hash;
 }
 
+/*
+ * distances between a box and a goal position are the minimum number of pushes needed to get the box
+ * there with the walls taken into account (see level.c), so they are never lower than the plain
+ * difference of steps in the x and y direction. a box that can reach no goal position at all makes
+ * the state unsolvable, and HEURISTIC_DEAD is returned for it.
+ * the cursor distance is still the difference of steps, as the cursor walks around the boxes
+ */
+
 // (A) find the box with the lowest distance from goal position
 // (B) and for the rest boxes that aren't in goal position add a penalty per box given by OPTIMALITY_STRICTNESS.
 // for the heuristic to be fully optimal, the OPTIMALITY_STRICTNESS assumes you will only need one move
 // per box to move to goal position. you can change this to something more reasonable but optimality may be sacrificed.
 // the distance of the current cursor compared to the box in (A) is added to the final score as well.
-u_int heuristic_fixed_penalty(Coordinate *boxes, Coordinate *goal_positions, Coordinate *cursor, u_int num_boxes) {
+u_int heuristic_fixed_penalty(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
    u_int total_score = 0;
    u_int mismatched_boxes_count = num_boxes;
    u_int cursor_closest = 0;
@@ -61,25 +113,17 @@ u_int heuristic_fixed_penalty(Coordinate *boxes, Coordinate *goal_positions, Coo
    u_int global_min_score = UINT_MAX;
    
    for (u_int i = 0; i < num_boxes; i++) {
-      u_int local_min_score = UINT_MAX;
-      u_int score;
-      for (u_int c = 0; c < num_boxes; c++) {
-         
-         // get score for box i and pos i
-         score = abs(boxes[i].x-goal_positions[c].x) + \
-         abs(boxes[i].y-goal_positions[c].y);
-         if (score == 0)
-            break;
-         
-         if (local_min_score > score) 
-            local_min_score = score;
-         
-      }
-      if (score == 0) // if the box isn't in goal position then we can count its minimum score
+      u_int local_min_score = min_push_distance(level, &boxes[i]);
+      
+      if (local_min_score == UNREACHABLE)
+         return HEURISTIC_DEAD;
+      
+      if (local_min_score == 0) // if the box isn't in goal position then we can count its minimum score
          mismatched_boxes_count--;
       else if (global_min_score > local_min_score) {
-         cursor_closest =  abs(boxes[i].x-cursor->x) + \
-                              abs(boxes[i].y-cursor->y);
+         if (cursor != NULL)
+            cursor_closest =  abs(boxes[i].x-cursor->x) + \
+                                 abs(boxes[i].y-cursor->y);
          global_min_score = local_min_score;
       }
    }
@@ -92,7 +136,9 @@ u_int heuristic_fixed_penalty(Coordinate *boxes, Coordinate *goal_positions, Coo
 // box chooses from the remaining N-1, and so on. 
 // NON-OPTIMAL
 // the minimum distance of the current cursor compared to all the boxes is added to the final score as well.
-u_int heuristic_coarse_match(Coordinate *boxes, Coordinate *goal_positions, Coordinate *cursor, u_int num_boxes) {
+u_int heuristic_coarse_match(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
    u_int total_score = 0;
    _Bool used_goal_positions[num_boxes];
    u_int cursor_closest = UINT_MAX;
@@ -101,7 +147,7 @@ u_int heuristic_coarse_match(Coordinate *boxes, Coordinate *goal_positions, Coor
       used_goal_positions[x] = False;
    
    for (u_int i = 0; i < num_boxes; i++) {
-
+   
       
       u_int local_min_score = UINT_MAX;
       u_int min_box = 0;
@@ -110,8 +156,7 @@ u_int heuristic_coarse_match(Coordinate *boxes, Coordinate *goal_positions, Coor
             continue;
          
          // get score for box i and pos i
-         u_int score = abs(boxes[i].x-goal_positions[c].x) + \
-                           abs(boxes[i].y-goal_positions[c].y);
+         u_int score = push_distance(level, &boxes[i], c);
          
          
          if (local_min_score > score) {
@@ -119,7 +164,13 @@ u_int heuristic_coarse_match(Coordinate *boxes, Coordinate *goal_positions, Coor
             min_box = c;
          }
       }
-      if (local_min_score != 0) {
+      // the goal positions left may all be out of reach for this box even though others aren't
+      if (local_min_score == UNREACHABLE) {
+         local_min_score = min_push_distance(level, &boxes[i]);
+         if (local_min_score == UNREACHABLE)
+            return HEURISTIC_DEAD;
+      }
+      if ((local_min_score != 0) && (cursor != NULL)) {
          u_int temp =  abs(boxes[i].x-cursor->x) + \
                   abs(boxes[i].y-cursor->y);
          if (temp < cursor_closest)
@@ -129,33 +180,29 @@ u_int heuristic_coarse_match(Coordinate *boxes, Coordinate *goal_positions, Coor
       total_score += local_min_score;
    }
    
+   if (cursor == NULL)
+      return total_score;
    return (total_score == 0) ? 0 : total_score + cursor_closest;
-
+   
 }
 
 // calculate the distance between the boxes and all the goal positions 
 // and add the minimum distance per box to final score.
 // OPTIMAL
 // the minimum distance of the current cursor compared to all the boxes is added to the final score as well.
-u_int heuristic_match_closest(Coordinate *boxes, Coordinate *goal_positions, Coordinate *cursor, u_int num_boxes) {
+u_int heuristic_match_closest(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
    u_int total_score = 0;   
    u_int cursor_closest = UINT_MAX;
    
    for (u_int i = 0; i < num_boxes; i++) {
-
+      u_int local_min_score = min_push_distance(level, &boxes[i]);
       
-      u_int local_min_score = UINT_MAX;
-      for (u_int c = 0; c < num_boxes; c++) {
-         
-         // get score for box i and pos i
-         u_int score = abs(boxes[i].x-goal_positions[c].x) + \
-                        abs(boxes[i].y-goal_positions[c].y);
-         
-         if (score < local_min_score) 
-            local_min_score = score;
-         
-      }
-      if (local_min_score != 0) {
+      if (local_min_score == UNREACHABLE)
+         return HEURISTIC_DEAD;
+      
+      if ((local_min_score != 0) && (cursor != NULL)) {
          u_int temp = abs(boxes[i].x-cursor->x) + \
                               abs(boxes[i].y-cursor->y);
          if (temp < cursor_closest)
@@ -163,15 +210,62 @@ u_int heuristic_match_closest(Coordinate *boxes, Coordinate *goal_positions, Coo
       }
       total_score += local_min_score;
    }
-   if (total_score == 0)
-      return 0;
+   if ((total_score == 0) || (cursor == NULL))
+      return total_score;
    total_score += cursor_closest;
    return total_score;
 }
 
+// minimum cost perfect matching between the boxes and the goal positions (see matching.c),
+// unlike match_closest every goal position takes exactly one box.
+// the matching of the previous call is kept and only the boxes that moved since are reassigned,
+// which between a parent and its children is at most one box.
+// OPTIMAL
+// the minimum distance of the current cursor compared to all the boxes is added to the final score as well.
+u_int heuristic_min_matching(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   Level *level = search->level;
+   Matching *matching = search->matching;
+   u_int num_boxes = level->num_boxes;
+   int costs[num_boxes];
+   u_int cursor_closest = UINT_MAX;
+   
+   for (u_int i = 0; i < num_boxes; i++) {
+      u_short cell = level_cell(level, &boxes[i]);
+      
+      if (matching->row_key[i] != cell) {
+         for (u_int c = 0; c < num_boxes; c++) {
+            u_short score = push_distance(level, &boxes[i], c);
+            costs[c] = (score == UNREACHABLE) ? MATCHING_NO_EDGE : score;
+         }
+         set_row_matching(matching, i, costs);
+         matching->row_key[i] = cell;
+      }
+      
+      if ((cursor != NULL) && (level->min_push_dist[cell] != 0)) {
+         u_int temp = abs(boxes[i].x-cursor->x) + \
+                              abs(boxes[i].y-cursor->y);
+         if (temp < cursor_closest)
+            cursor_closest = temp;
+      }
+   }
+   
+   long total_score = solve_matching(matching);
+   if (total_score >= MATCHING_NO_EDGE)
+      return HEURISTIC_DEAD;
+   if ((total_score == 0) || (cursor == NULL))
+      return total_score;
+   return total_score + cursor_closest;
+}
+
 // calculate the number of boxes not in goal positions 
 // OPTIMAL
-u_int heuristic_count_boxes(Coordinate *boxes, Coordinate *goal_positions, Coordinate *cursor, u_int num_boxes) {
+// 
+// all the heuristics take a NULL cursor in push mode, where the score counts pushes only
+// and the cursor distance is left out
+u_int heuristic_count_boxes(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
+   Coordinate *goal_positions = level->goal_positions;
    u_int total_score = num_boxes;   
    
    for (u_int i = 0; i < num_boxes; i++) {
@@ -182,485 +276,733 @@ u_int heuristic_count_boxes(Coordinate *boxes, Coordinate *goal_positions, Coord
             total_score--;
          }
    }
-
+   
    return total_score;
 }
 
-int compare_state(void *present_state, void *new_state) {
-   State *ps = present_state;
-   State *ns = new_state;
-   u_int p_score = ps->heuristic_score + ps->cost_score;
-   u_int n_score = ns->heuristic_score + ns->cost_score;
-   
-   if (p_score > n_score)
-      return 1;
-   if (p_score < n_score)
-      return -1;
+/*
+ * incremental forms of the heuristics above. when a state is expanded the minimum push distance of
+ * each of its boxes is cached once (see prepare_heuristic), and a child only looks up the box it moved.
+ * the cursor distance is still taken over every box, but that is only a few subtractions per box.
+ * coarse_match depends on the order of all the boxes and is always computed from scratch, and
+ * min_matching already reassigns only the boxes that moved (see heuristic_min_matching)
+ */
+
+static void prepare_box_scores(Search *search, Coordinate *boxes) {
+   HeuristicCache *cache = &search->cache;
+   
+   cache->total = 0;
+   cache->off_goal = 0;
+   cache->closest[0] = cache->closest[1] = NO_BOX;
+   for (u_int i = 0; i < search->level->num_boxes; i++) {
+      u_int score = min_push_distance(search->level, &boxes[i]);
+      cache->box_score[i] = score;
+      cache->total += score;
+      if (score == 0)
+         continue;
+      
+      cache->off_goal++;
+      if ((cache->closest[0] == NO_BOX) || (score < cache->box_score[cache->closest[0]])) {
+         cache->closest[1] = cache->closest[0];
+         cache->closest[0] = i;
+      } else if ((cache->closest[1] == NO_BOX) || (score < cache->box_score[cache->closest[1]]))
+         cache->closest[1] = i;
+   }
+}
+
+// distance from the cursor to the closest box off its goal position, moved_score is the score of the moved box
+static u_int closest_box_distance(Search *search, Coordinate *boxes, Coordinate *cursor, u_int moved_score) {
+   HeuristicCache *cache = &search->cache;
+   u_int cursor_closest = UINT_MAX;
    
-   return 0;
+   for (u_int i = 0; i < search->level->num_boxes; i++) {
+      u_int score = (i == cache->moved_box) ? moved_score : cache->box_score[i];
+      if (score == 0)
+         continue;
+      u_int temp = abs(boxes[i].x-cursor->x) + abs(boxes[i].y-cursor->y);
+      if (temp < cursor_closest)
+         cursor_closest = temp;
+   }
+   return cursor_closest;
 }
 
-/* deadlock scenarios:
-*         if there is a wall on at least one side of the box in the x-axis AND in the y-axis
-*         if a box is locked and can only move to one direction only and in that direction there are no goal positions 
-* !!! a box is counted as a space, meaning only walls are taken into consideration, so deadlocks caused by boxes sticked together goes undetected!!!
-*/
-_Bool simple_deadlock_detect(char **puzzle, Coordinate *boxes, int num_boxes) {
+static u_int update_count_boxes(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   HeuristicCache *cache = &search->cache;
+   u_int box = cache->moved_box;
    
-   for (int bx = 0; bx < num_boxes; bx++) {
-      u_char x = boxes[bx].x;
-      u_char y = boxes[bx].y;
+   if (box == NO_BOX)
+      return cache->off_goal;
+   return cache->off_goal + (min_push_distance(search->level, &boxes[box]) != 0) - (cache->box_score[box] != 0);
+}
 
-      if (puzzle[x][y] == '.') 
-         continue;
-      
-      _Bool x_lock = False;
-      _Bool y_lock = False;
-      
-      // check if box is permanently stuck (wall check only)
-      if (puzzle[x-1][y] == '#' || (puzzle[x+1][y] == '#'))  
-         x_lock = True;
-         
-      if ((puzzle[x][y-1] == '#') || (puzzle[x][y+1] == '#'))
-         y_lock = True;
-      
-      if (x_lock && y_lock)
-         return True;
-      
-      // check if box can move to a single direction only
-      // and further check if there is a goal in that direction it can move
-      // if there isn't then DEADLOCK
-      
-      int ptr = y;
-      for (; puzzle[x][ptr] != '#'; ptr--) ;
-      ptr++;
-      
-      _Bool way_out = False;
-      for (; puzzle[x][ptr] != '#'; ptr++) 
-         if ((puzzle[x][ptr] == '.') || \
-            ((puzzle[x-1][ptr] != '#') && (puzzle[x+1][ptr] != '#'))) {
-            way_out = True;
-            break;
-         }
-      if (! way_out) 
-         return True;
-      
-      ptr = x;
-      for (; puzzle[ptr][y] != '#'; ptr--) ;
-      ptr++;
-      
-      way_out = False;
-      for (; puzzle[ptr][y] != '#'; ptr++) 
-         if ((puzzle[ptr][y] == '.') || \
-            ((puzzle[ptr][y-1] != '#') && (puzzle[ptr][y+1] != '#'))) {
-            way_out = True;
-            break;
-         }
-            
-      if (! way_out) 
-         return True;
+static u_int update_match_closest(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   HeuristicCache *cache = &search->cache;
+   u_int box = cache->moved_box;
+   u_int total_score = cache->total;
+   u_int moved_score = 0;
+   
+   if (box != NO_BOX) {
+      moved_score = min_push_distance(search->level, &boxes[box]);
+      if (moved_score == UNREACHABLE)
+         return HEURISTIC_DEAD;
+      total_score = total_score - cache->box_score[box] + moved_score;
+   }
+   if ((total_score == 0) || (cursor == NULL))
+      return total_score;
+   return total_score + closest_box_distance(search, boxes, cursor, moved_score);
+}
+
+// the box of lowest score is the cached one, or the runner up if that one moved, or else the moved box
+static u_int update_fixed_penalty(Search *search, Coordinate *boxes, Coordinate *cursor) {
+   HeuristicCache *cache = &search->cache;
+   u_int box = cache->moved_box;
+   u_int mismatched_boxes_count = cache->off_goal;
+   u_int closest = cache->closest[0];
+   u_int moved_score = 0;
+   
+   if (box != NO_BOX) {
+      moved_score = min_push_distance(search->level, &boxes[box]);
+      if (moved_score == UNREACHABLE)
+         return HEURISTIC_DEAD;
+      mismatched_boxes_count = mismatched_boxes_count + (moved_score != 0) - (cache->box_score[box] != 0);
       
+      if (closest == box)
+         closest = cache->closest[1];
+      if ((moved_score != 0) && ((closest == NO_BOX) || (moved_score < cache->box_score[closest]) ||
+         ((moved_score == cache->box_score[closest]) && (box < closest))))
+         closest = box;
    }
+   if (mismatched_boxes_count == 0)
+      return 0;
    
-   return False;
+   u_int global_min_score = (closest == box) ? moved_score : cache->box_score[closest];
+   u_int total_score = mismatched_boxes_count*OPTIMALITY_STRICTNESS + global_min_score;
+   if (cursor != NULL)
+      total_score += abs(boxes[closest].x-cursor->x) + abs(boxes[closest].y-cursor->y);
+   return total_score;
 }
 
-void print_state(char **puzzle, State *sol, int num_boxes, int puzzle_length) {
-   printf("-----------------\n");
+int init_heuristic(Search *search, u_int (*func)(Search *, Coordinate *, Coordinate *)) {
+   search->heuristic_func = func;
+   search->heuristic_update = NULL;
+   search->cache.state = NO_STATE;
+   search->cache.moved_box = NO_BOX;
+   
+   if (func == heuristic_count_boxes)
+      search->heuristic_update = update_count_boxes;
+   else if (func == heuristic_fixed_penalty)
+      search->heuristic_update = update_fixed_penalty;
+   else if (func == heuristic_match_closest)
+      search->heuristic_update = update_match_closest;
+   else
+      return 0;
    
-   char **puzzle_cpy = malloc(sizeof(char *) * puzzle_length);
+   search->cache.box_score = malloc(sizeof(u_int) * search->level->num_boxes);
+   return search->cache.box_score == NULL;
+}
+
+void prepare_heuristic(Search *search, u_int state_id, Coordinate *boxes) {
+   if (search->heuristic_update == NULL)
+      return;
+   prepare_box_scores(search, boxes);
+   search->cache.state = state_id;
+   search->cache.moved_box = NO_BOX;
+}
+
+// the full computation is kept for the states the cache knows nothing of, like the roots, the children
+// sent by other threads (see hda.c) and the pulls of the backward search (see bidir.c).
+// the debug build checks every incremental score against it
+u_int child_heuristic(Search *search, u_int parent_id, Coordinate *boxes, Coordinate *cursor) {
+   if ((parent_id == NO_STATE) || (search->cache.state != parent_id))
+      return search->heuristic_func(search, boxes, cursor);
    
-   for (int i = 0; i < puzzle_length; i++) {
-      puzzle_cpy[i] = malloc(sizeof(char) * (strlen(puzzle[i])+1));
-      strcpy(puzzle_cpy[i], puzzle[i]);
-   }
+   u_int score = search->heuristic_update(search, boxes, cursor);
+#ifdef DEBUG
+   if (score != search->heuristic_func(search, boxes, cursor))
+      err_exit("Incremental heuristic score differs from the full one");
+#endif
+   return score;
+}
 
-   for (int i = 0; i < num_boxes; i++) 
-       puzzle_cpy[sol->boxes[i].x][sol->boxes[i].y] = ( puzzle_cpy[sol->boxes[i].x][sol->boxes[i].y] == '.') ? '*' : '$';
+State *get_state(Search *search, u_int id) {
+   return get_arena(search->arena, id);
+}
+
+u_short cell_index(Search *search, int x, int y) {
+   return x * search->level->width + y;
+}
+
+void cell_coordinate(Search *search, u_short cell, Coordinate *pos) {
+   pos->x = cell / search->level->width;
+   pos->y = cell % search->level->width;
+}
+
+void unpack_state(Search *search, State *state, Coordinate *cursor, Coordinate *boxes) {
+   cell_coordinate(search, state->current_pos, cursor);
+   for (u_int i = 0; i < search->level->num_boxes; i++)
+      cell_coordinate(search, state->boxes[i], &boxes[i]);
+}
+
+void print_state(Search *search, State *sol) {
+   printf("-----------------\n");
+   
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
+   char grid[level->num_cells];
+   memcpy(grid, level->grid, level->num_cells);
    
-   puzzle_cpy[sol->current_pos->x][sol->current_pos->y] = ( puzzle_cpy[sol->current_pos->x][sol->current_pos->y] == '.') ? '+' : '@';
+   for (u_int i = 0; i < num_boxes; i++) 
+       grid[sol->boxes[i]] = (grid[sol->boxes[i]] == '.') ? '*' : '$';
+   
+   grid[sol->current_pos] = (grid[sol->current_pos] == '.') ? '+' : '@';
    
    
    printf("move score:    %d\n", sol->cost_score);
    printf("heuristic:    %d\n\n", sol->heuristic_score);
    
-   for (int i = 0; i < puzzle_length; i++) 
-      printf("%s\n", puzzle_cpy[i]);
+   // the padding is left out, as are the cells past the end of a line
+   char line[level->width + 1];
+   for (u_int x = LEVEL_PADDING; x < level->height - LEVEL_PADDING; x++) {
+      u_int length = 0;
+      for (u_int y = LEVEL_PADDING; y < level->width - LEVEL_PADDING; y++)
+         if (grid[x * level->width + y] != GRID_OUTSIDE)
+            line[length++] = grid[x * level->width + y];
+      line[length] = 0;
+      printf("%s\n", line);
+   }
    
    printf("-----------------\n");
       
 }
 
-State *get_duplicate(Queue *queue, Coordinate *new_cursor_pos, Coordinate *new_boxes, int num_boxes) {
-
-   Node *ptr = queue->head;
-   while (ptr != NULL) {
-
-      State *state = ptr->data;
-      if ((state->current_pos->x != new_cursor_pos->x) ||
-         (state->current_pos->y != new_cursor_pos->y)) {
-         ptr = ptr->next;
-         continue;
-      }
-      _Bool identical_states = True;
-      for (int i = 0; i < num_boxes; i++) {
-         _Bool identical_boxes = False;
-         for (int j = 0; j < num_boxes; j++)
-            if ((state->boxes[i].x == new_boxes[j].x) &&
-               (state->boxes[i].y == new_boxes[j].y)) {
-               identical_boxes = True;
-               break;
-            }
-         if (identical_boxes == False) {
-            ptr = ptr->next;
-            identical_states = False;
+// box order is not significant, two states are equal if they hold the same set of boxes
+int equal_state(u_int stored_state, void *state_key) {
+   StateKey *key = state_key;
+   State *state = get_state(key->search, stored_state);
+   u_int num_boxes = key->search->level->num_boxes;
+   
+   if (state->current_pos != key->current_pos)
+      return 0;
+   
+   for (u_int i = 0; i < num_boxes; i++) {
+      _Bool identical_boxes = False;
+      for (u_int j = 0; j < num_boxes; j++)
+         if (state->boxes[i] == key->boxes[j]) {
+            identical_boxes = True;
             break;
          }
-      }
-      if (identical_states)
-         return state;
-      
+      if (identical_boxes == False)
+         return 0;
    }
-   return NULL;
+   return 1;
+}
 
+// look up a state in the table holding every state generated so far (both expanded and waiting in the queue)
+u_int get_duplicate(Search *search, uint64_t hash, u_short new_cursor_pos, u_short *new_boxes) {
+   StateKey key = { search, new_cursor_pos, new_boxes };
+   return lookup_table(search->table, hash, &key, equal_state);
 }
 
-void getSolution(State *sol, char *str) {
-   if (sol->parent == NULL)
+#ifdef DEBUG
+void print_table_stats(Search *search) {
+   Table *table = search->table;
+   printf("state table size: %u\n", table->length);
+   printf("state table load factor: %.3f\n", load_factor_table(table));
+   printf("state table probe length: avg %.3f, max %u\n",
+          table->lookups ? (double) table->probes / table->lookups : 0.0, table->max_probe);
+   printf("state arena: %u states of %u bytes, %zu bytes allocated\n",
+          search->arena->length, search->arena->stride, size_arena(search->arena));
+   printf("matching: %lu full solves, %lu repaired rows\n",
+          search->matching->full_solves, search->matching->repaired_rows);
+   printf("freeze deadlocks: %lu children pruned\n", search->freeze_pruned);
+   printf("deadlock patterns: %lu loaded, %lu searched, %lu learned, %lu children pruned\n",
+          search->patterns->loaded, search->patterns->searches, search->patterns->learned, search->patterns->pruned);
+}
+#endif
+
+const char *move_name(u_char move) {
+   switch (move) {
+      case (0): return "up";
+      case (1): return "down";
+      case (2): return "left";
+      case (3): return "right";
+   }
+   return "";
+}
+
+void getSolution(Search *search, u_int sol, char *str) {
+   State *state = get_state(search, sol);
+   if (state->parent == NO_STATE)
       return;
-   getSolution(sol->parent, str);
+   getSolution(search, state->parent, str);
    
-   switch (sol->move_from_parent) {
-      case (0): strcat(str, "up ");break;
-      case (1): strcat(str, "down ");break;
-      case (2): strcat(str, "left ");break;
-      case (3): strcat(str, "right ");break;
+   strcat(str, move_name(state->move_from_parent));
+   strcat(str, " ");
+}   
+
+// heuristic part of the frontier key, inflated by the weight of the anytime search (see ara.c)
+static u_int frontier_heuristic(Search *search, u_int heuristic) {
+   return (search->ara == NULL) ? heuristic : weighted_heuristic(search->ara, heuristic);
+}
+
+/*
+ * the state reached from parent_id by move is looked up in the state table, if it is new it is
+ * stored and put in the frontier. if it was seen before but is now reached with a lower move score,
+ * the stored state takes the new path and is moved up in the frontier, or put back in it if
+ * it was already expanded
+ */
+int insert_child(Search *search, u_int parent_id, u_char parent_thread, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   u_int num_boxes = search->level->num_boxes;
+   
+   uint64_t started = STATS_START(search);
+   u_char symmetry = 0;
+   u_int identical = (search->symmetry != NULL) ? symmetric_duplicate(search, &hash, cursor, cells, &symmetry) :
+                                                  get_duplicate(search, hash, cursor, cells);
+   STATS_STOP(search, duplicate_ticks, started);
+   if (identical != NO_STATE) {
+      State *identical_state = get_state(search, identical);
+      _Bool open = contains_pqueue(search->states, identical);
+      
+      if (open)
+         STATS_ADD(search, duplicates_open);
+      else
+         STATS_ADD(search, duplicates_closed);
+      
+      if (identical_state->cost_score > cost) { // lower cost state substitution
+         identical_state->parent = parent_id;
+         identical_state->parent_thread = parent_thread;
+         identical_state->move_from_parent = move | (symmetry << MOVE_BITS);
+         identical_state->cost_score = cost;
+         
+         int ret;
+         started = STATS_START(search);
+         u_int heuristic = frontier_heuristic(search, identical_state->heuristic_score);
+         if (open)
+            ret = update_pqueue(search->states, identical, identical_state->cost_score, heuristic);
+         else if ((search->ara != NULL) && closed_state(search->ara, identical))
+            ret = defer_state(search->ara, identical);   // expanded again in the next pass
+         else {
+            // already expanded, its children have to be revisited with the lower cost
+            STATS_ADD(search, reopened);
+            ret = insert_pqueue(search->states, identical, identical_state->cost_score, heuristic);
+         }
+         STATS_STOP(search, queue_ticks, started);
+         return ret;
+      }
+      return 0;
    }
    
-}   
+   started = STATS_START(search);
+   u_int heuristic_score = child_heuristic(search, parent_id, boxes, cursor_pos);
+   STATS_STOP(search, heuristic_ticks, started);
+   if (heuristic_score == HEURISTIC_DEAD)
+      return 0;
+   
+   u_int new_id = alloc_arena(search->arena);
+   if (new_id == ARENA_NULL)
+      return 1;
+   
+   State *new_state = get_state(search, new_id);
+   new_state->parent = parent_id;
+   new_state->parent_thread = parent_thread;
+   new_state->move_from_parent = move;
+   new_state->current_pos = cursor;
+   memcpy(new_state->boxes, cells, sizeof(u_short) * num_boxes);
+   new_state->cost_score = cost;
+   new_state->heuristic_score = heuristic_score;
+   
+   if (search->verbose) {
+      printf("Accepted Move: %d \n", move);
+      print_state(search, new_state);
+   }
+   
+   started = STATS_START(search);
+   int ret = insert_pqueue(search->states, new_id, new_state->cost_score, frontier_heuristic(search, heuristic_score));
+   STATS_STOP(search, queue_ticks, started);
+   if (ret || insert_table(search->table, hash, new_id))
+      return 1;
+   return 0;
+}
+
+// the child is handed to the thread owning its hash in the parallel search (see hda.c),
+// kept for the depth first search in the iterative deepening mode (see ida.c) or the next depth of the beam (see beam.c)
+// or checked against the other end in the bidirectional mode (see bidir.c)
+int add_child(Search *search, u_int parent_id, u_char move, u_int steps, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes) {
+   u_int cost = get_state(search, parent_id)->cost_score + steps;
+   
+   if (search->ida != NULL)
+      return collect_child(search, parent_id, cost, move, hash, cursor, cells, cursor_pos, boxes);
+   if (search->beam != NULL)
+      return beam_child(search, parent_id, cost, move, hash, cursor, cells, cursor_pos, boxes);
+   if (search->bidir != NULL)
+      return meet_child(search, parent_id, cost, move, hash, cursor, cells, cursor_pos, boxes);
+   if (search->hda != NULL)
+      return send_child(search, parent_id, cost, move, hash, cursor, cells, cursor_pos, boxes);
+   return insert_child(search, parent_id, 0, cost, move, hash, cursor, cells, cursor_pos, boxes);
+}
 
 /*
- * to save space, we use lightweight states, meaning only the coordinates of the boxes are stored in each state.
- * But because a puzzle matrix is useful to help in the computations, the boxes of the state are
- * inserted to the puzzle at each run of this function and then removed
- * 
- * So the puzzle variable holds the puzzle matrix with only the walls and the goal positions
- * and the puzzle_temp is an empty puzzle matrix that we use in this function to insert the boxes
- * coordinates in, and then upon finishing of the function we clear it
+ * to save space, we use lightweight states, meaning only the cells of the boxes are stored in each state.
+ * The boxes of the expanded state are marked on the box map, a grid of the size of the puzzle, at each
+ * run of this function and cleared again at the end, so that the neighbours of the cursor are looked up
+ * by adding the move offsets to its cell. The padding of walls around the grid keeps every neighbour
+ * of a floor cell inside of it
  * 
  * Given one root state this function will attempt to make all other four children from this state (all 4 positions)
  * but a child is not inserted if:
- *         Satisfied the deadlock criteria (see simple_deadlock_detect function)
- *         is found in the history or running queue. (if it is found but the new state has lower move score, the states are replaced)
+ *         a box is pushed on a dead square (see level.c)
+ *         the push freezes boxes off their goal positions (see deadlock.c)
+ *         the box ends up in a window of boxes proven dead (see pattern.c)
+ *         is found in the state table (see add_child function)
  */
-int make_move(char **puzzle, char **puzzle_temp, Queue *states, Queue *history, State *current_state, Coordinate *goal_positions, u_int num_boxes, u_int (*heuristic_func)(Coordinate *, Coordinate *, Coordinate *, u_int),u_int puzzle_size, _Bool verbose) {  
+int make_move(Search *search, u_int state_id) {  
+   
+   Level *level = search->level;
+   u_int num_boxes = level->num_boxes;
+   int *offsets = level->offsets;
    
-   // set boxes to graph
-   for (u_int i = 0 ; i < num_boxes; i++) 
-      puzzle_temp[current_state->boxes[i].x][current_state->boxes[i].y] = (i+1);
+   State *current_state = get_state(search, state_id);
+   STATS_EXPAND(search);
    
-   Coordinate *cur_pos = current_state->current_pos;
+   Coordinate cur_pos;
+   Coordinate boxes[num_boxes];
+   u_short cells[num_boxes];
+   unpack_state(search, current_state, &cur_pos, boxes);
+   memcpy(cells, current_state->boxes, sizeof(u_short) * num_boxes);
+   u_short cursor = current_state->current_pos;
    
-   char x_offsets[] = { -1 , 1, 0, 0 };
-   char y_offsets[] = { 0, 0, -1, 1 };
+   uint64_t hash = hash_state(&search->zobrist, &cur_pos, boxes, num_boxes);
+   prepare_heuristic(search, state_id, boxes);
+   
+   for (u_int i = 0 ; i < num_boxes; i++)
+      search->box_map[cells[i]] = (i+1);
    
    for (int mv = 0; mv < 4; mv++) {
-      int new_x = cur_pos->x + x_offsets[mv];
-      int new_y = cur_pos->y + y_offsets[mv];
+      u_short new_cell = cursor + offsets[mv];
+      u_short beyond = new_cell + offsets[mv];
       
       // if it's a wall
-      if (puzzle[ new_x ][ new_y ] == '#') 
+      if (level->walls[new_cell]) 
          continue;
       
-      if ((puzzle_temp[ new_x ][ new_y ] > 0) &&  // if it's a box
-         ((puzzle[ new_x + x_offsets[mv] ][ new_y + y_offsets[mv] ] == '#') ||
-         (puzzle_temp[ new_x + x_offsets[mv] ][ new_y + y_offsets[mv] ] > 0)))
-         // no space for box to move upwards
+      if (search->box_map[new_cell] && (level->walls[beyond] || search->box_map[beyond]))
+         // no space for box to move
          continue;
-
-      Coordinate new_pos = { new_x, new_y };
+   
+      Coordinate new_pos;
+      cell_coordinate(search, new_cell, &new_pos);
+      STATS_ADD(search, generated);
       
-      _Bool valid = True;
-      u_int box_id = puzzle_temp[new_x][new_y] - 1;
+      _Bool valid = True;  // deadlocked children are not even looked up
+      _Bool box_moved = (search->box_map[new_cell] != 0);
+      u_int box_id = search->box_map[new_cell] - 1;
+      uint64_t new_hash = hash ^ search->zobrist.cursor[cursor] ^ search->zobrist.cursor[new_cell];
       
-      if (puzzle_temp[ new_x ][ new_y ] != 0) { // if a box moved
+      if (box_moved) {
+         new_hash ^= search->zobrist.boxes[new_cell] ^ search->zobrist.boxes[beyond];
          
-         current_state->boxes[box_id].x = new_x + x_offsets[mv];
-         current_state->boxes[box_id].y = new_y + y_offsets[mv];
+         cells[box_id] = beyond;
+         cell_coordinate(search, beyond, &boxes[box_id]);
+         search->box_map[new_cell] = 0;
+         search->box_map[beyond] = box_id+1;
          
-         if (simple_deadlock_detect(puzzle, current_state->boxes, num_boxes)) // is deadlock detected ?
+         uint64_t started = STATS_START(search);
+         if (level->dead[beyond] || freeze_deadlock(search, cells, box_id) ||
+            pattern_deadlock(search, cells, box_id)) { // is deadlock detected ?
             valid = False;
+            STATS_ADD(search, deadlock_pruned);
+         }
+         STATS_STOP(search, deadlock_ticks, started);
          
       }
-
-      State *identical = NULL;
-      if (valid && (NULL != (identical = get_duplicate(history, &new_pos, current_state->boxes, num_boxes))))
-          valid = False;
-       if (valid && (NULL != (identical = get_duplicate(states, &new_pos, current_state->boxes, num_boxes))))
-          valid = False;
-
-      if ((identical != NULL) && (identical->cost_score > current_state->cost_score+1)) { // lower cost state substitution
-         identical->parent = current_state->parent;
-         identical->move_from_parent = mv;
-         identical->cost_score = current_state->cost_score+1;
-      }
+   
+      search->cache.moved_box = box_moved ? box_id : NO_BOX;
+      if (valid && add_child(search, state_id, mv, 1, new_hash, new_cell, cells, &new_pos, boxes))
+         return 1;
       
-      if (puzzle_temp[new_x][new_y] != 0) {
+      if (box_moved) {
          // revert changes in box
-         current_state->boxes[box_id].x = new_x;
-         current_state->boxes[box_id].y = new_y;
+         search->box_map[beyond] = 0;
+         search->box_map[new_cell] = box_id+1;
+         cells[box_id] = new_cell;
+         cell_coordinate(search, new_cell, &boxes[box_id]);
       }
-      
-      if (!valid)
-         continue;
-      
-
-      Coordinate *cursor = malloc(sizeof(Coordinate));
-      Coordinate *new_boxes = malloc(sizeof(Coordinate)*num_boxes);
-      State *new_state = malloc(sizeof(State));
-      memcpy(new_boxes, current_state->boxes, sizeof(Coordinate)*num_boxes);
-         
-      if (puzzle_temp[new_x][new_y] != 0) {
-         new_boxes[box_id].x = new_x + x_offsets[mv];
-         new_boxes[box_id].y = new_y + y_offsets[mv];
-      }
-      cursor->x = new_x;
-      cursor->y = new_y;
-      new_state->move_from_parent = mv;
-      new_state->parent = current_state;
-      new_state->current_pos = cursor;
-      new_state->boxes = new_boxes;
-      new_state->cost_score = current_state->cost_score+1;
-      new_state->heuristic_score = heuristic_func(new_boxes, goal_positions, cursor, num_boxes);
-      
-      if (verbose) {
-         printf("Accepted Move: %d \n", mv);
-         print_state(puzzle, new_state, num_boxes, puzzle_size);
-      }
-      
-      insert_sorted_queue(states, new_state, compare_state);
    }
    
-   // unset boxes to graph
-   for (u_int i = 0 ; i < num_boxes; i++) 
-      puzzle_temp[current_state->boxes[i].x][current_state->boxes[i].y] = 0;
+   for (u_int i = 0 ; i < num_boxes; i++)
+      search->box_map[cells[i]] = 0;
+   search->cache.state = NO_STATE;
    
    return 0;   
 }
 
-State *search_solution(char **puzzle, char **puzzle_temp, Queue *states,Queue *history, Coordinate *goal_positions, u_int num_boxes, u_int (*heuristic_func)(Coordinate *, Coordinate *, Coordinate *, u_int), u_int puzzle_size, _Bool verbose) {
-   int nodes = 1;
+_Bool over_limits(Search *search) {
+   if ((search->deadline > 0) && (now_seconds() > search->deadline))
+      search->stopped = SEARCH_TIME_LIMIT;
+   else if ((search->memory_limit > 0) &&
+      (size_arena(search->arena) + size_table(search->table) + size_pqueue(search->states) > search->memory_limit))
+      search->stopped = SEARCH_MEMORY_LIMIT;
+   return search->stopped != SEARCH_RUNNING;
+}
+
+u_int search_solution(Search *search) {
+   search->nodes = 1;
+   unsigned long spilled_at = 0;
    
-   while (states->length > 0) {
-      State *state = remove_head_queue(states);
+   for (;;) {
+      if ((search->spill != NULL) && refill_frontier(search)) {
+         search->stopped = SEARCH_OUT_OF_MEMORY;
+         return NO_STATE;
+      }
+      if (search->states->length == 0)
+         break;
+      
+      u_int state_id = remove_min_pqueue(search->states);
+      State *state = get_state(search, state_id);
+      
+      if ((search->spill != NULL) && spilled_duplicate(search, state_id))
+         continue;
       
       if (state->heuristic_score == 0.0) {
-
-         printf("Found after %d nodes\n", nodes);
+   
+         if (!search->quiet)
+            printf("Found after %lu nodes\n", search->nodes);
+         if (!search->quiet && (search->spill != NULL))
+            printf("spilled %u times: %lu states written, %lu loaded back, %lu duplicates dropped\n",
+                   search->spill->spills, search->spill->written, search->spill->loaded, search->spill->dropped);
+         if (!search->quiet && (search->symmetry != NULL))
+            printf("%u symmetries: %lu children found mirrored\n", search->symmetry->count, search->symmetry->mirrored);
+         if (!search->quiet && (search->corral != NULL))
+            printf("PI-corrals: %lu pushes pruned\n", search->corral->pruned);
+         if (!search->quiet && (search->macros != NULL))
+            printf("macros: %u goal rooms, %lu children made by a macro\n", search->macros->num_rooms, search->macros->made);
 #ifdef DEBUG
-         printf("history queue size: %d\n", history->length);
+         print_table_stats(search);
 #endif
-         return state;
+         if ((search->spill != NULL) && (NO_STATE == (state_id = restore_path(search, state_id))))
+            search->stopped = SEARCH_OUT_OF_MEMORY;
+         if ((search->symmetry != NULL) && (NO_STATE == (state_id = unfold_path(search, state_id))))
+            search->stopped = SEARCH_OUT_OF_MEMORY;
+         return state_id;
+      }
+      if ((search->nodes % LIMIT_CHECK_INTERVAL == 0) && (search->nodes != spilled_at) && over_limits(search)) {
+         if ((search->stopped != SEARCH_MEMORY_LIMIT) || (search->spill == NULL))
+            return NO_STATE;
+         
+         // the state goes to disk with the rest of the frontier
+         search->stopped = SEARCH_RUNNING;
+         if (insert_pqueue(search->states, state_id, state->cost_score, state->heuristic_score) ||
+            spill_states(search)) {
+            search->stopped = SEARCH_OUT_OF_MEMORY;
+            return NO_STATE;
+         }
+         spilled_at = search->nodes;
+         continue;
       }
-      if (verbose) {
+      if (search->verbose) {
          printf("\n#########################\nExpanding State: \n");
-         print_state(puzzle, state, num_boxes, puzzle_size);
+         print_state(search, state);
       }
-      make_move(puzzle, puzzle_temp, states, history, state, goal_positions, num_boxes, heuristic_func, puzzle_size, verbose);
-      if (verbose) {
+      if (search->expand_func(search, state_id)) {
+         search->stopped = SEARCH_OUT_OF_MEMORY;
+         return NO_STATE;
+      }
+      if (search->verbose) {
          printf("#########################\n");
       }
       
-      insert_head_queue(history, state);
-      nodes++;
+      search->nodes++;
    }
-
+   
 #ifdef DEBUG
-   printf("Nodes processed: %d\n", nodes);
-   printf("history queue size: %d\n", history->length);
+   printf("Nodes processed: %lu\n", search->nodes);
+   print_table_stats(search);
 #endif
    
-   return NULL;
-}
-
-void help(char *prog_name) {
-   printf("usage: %s [--help] | [--silent] [heuristic algorithm]\n\
-\n\
-   Simple Sokoban puzzle solver\n\
-   Puzzle is read from stdin\n\
-\n\
-   Default heuristic algorithm is fixed_penalty\n\
-   Available Heuristic Algorithms:\n\
-      count_boxes\n\
-      fixed_penalty\n\
-      coarse_match\n\
-      match_closest\n\
-\n\
-   optional arguments:\n\
-   --help                  show this help message and exit\n\
-   --silent                Don't print intermediary states\n", prog_name);
-   exit(1);
-}   
-   
-int main(int argc, char **argv) { 
-   _Bool verbose = True;
-   u_int ind = 1;
-   
-   if (argc >= 2) {
-      if (strcmp(argv[1], "--silent") == 0) {
-         ind++;
-         verbose = False;
-      } else if (strcmp(argv[1], "--help") == 0)
-         help(argv[0]);
-   }
-   
-   u_int (*heuristic_funct)(Coordinate *, Coordinate *, Coordinate *, u_int) = heuristic_fixed_penalty;
-   if (argc > ind) {
-      if (strcmp(argv[ind], "count_boxes") == 0)
-         heuristic_funct = heuristic_count_boxes;
-      else if (strcmp(argv[ind], "fixed_penalty") == 0)
-         heuristic_funct = heuristic_fixed_penalty;
-      else if (strcmp(argv[ind], "coarse_match") == 0)
-         heuristic_funct = heuristic_coarse_match;
-      else if (strcmp(argv[ind], "match_closest") == 0)
-         heuristic_funct = heuristic_match_closest;
-      else {
-         char buff[100];
-         snprintf(buff, 100, "Unrecognised Algorithm: %s\n", argv[ind]); 
-         err_exit(buff);
-      }
-   }
-   
-   char temp[20];
-      
-   if (fgets(temp, 20, stdin) == NULL)
-      err_exit("Incorrect format of file");
-      
-   u_int puzzle_size = strtol(temp, NULL, 10);
-   
-   char line[PUZZLE_WIDTH_LIMIT];
-   char **puzzle= malloc(sizeof(char *) * puzzle_size);
-   char **puzzle_temp= malloc(sizeof(char *) * puzzle_size);
-   
-   if (puzzle== NULL)
-      err_exit("Memory Error");
-   
-   u_int line_number, width, boxes_id, goal_pos_id;
-   line_number = width = boxes_id = goal_pos_id = 0;
-   
-   Coordinate current_pos;
-   Coordinate *boxes = malloc(sizeof(Coordinate)*puzzle_size*puzzle_size);
-   Coordinate *goal_positions = malloc(sizeof(Coordinate)*puzzle_size*puzzle_size);
-   
-   while (fgets(line, PUZZLE_WIDTH_LIMIT, stdin) != NULL) {
+   return NO_STATE;
+}
 
-      if (line_number >= puzzle_size) {
-         err_exit("Found too many lines while reading puzzle\n");
-      }
-      width = strlen(line);
-      puzzle[line_number] = malloc(sizeof(char)*width);
-      puzzle_temp[line_number] = malloc(sizeof(char)*width);
-      
-      u_int i = 0;
-      for (char *ptr = line; *ptr; ptr++) {
-         puzzle_temp[line_number][i] = 0;
-         
-         switch (*ptr) {
-            case ' ':
-               puzzle[line_number][i] = ' ';
-               break;
-            case '#':
-               puzzle[line_number][i] = '#';
-               break;
-            case '*':
-               puzzle[line_number][i] = '.';
-               
-               goal_positions[goal_pos_id].x = line_number;
-               goal_positions[goal_pos_id].y = i;
-               goal_pos_id++;
-               
-               boxes[boxes_id].x = line_number;
-               boxes[boxes_id].y = i;
-               boxes_id++;
-               break;
-            case '$':
-               puzzle[line_number][i] = ' ';
-               
-               boxes[boxes_id].x = line_number;
-               boxes[boxes_id].y = i;
-               boxes_id++;
-               break;
-            case '+':
-               puzzle[line_number][i] = '.';
-               current_pos.x = line_number;
-               current_pos.y = i;
-               
-               goal_positions[goal_pos_id].x = line_number;
-               goal_positions[goal_pos_id].y = i;
-               goal_pos_id++;
-               break; 
-            case '.':
-               puzzle[line_number][i] = '.';
-               
-               goal_positions[goal_pos_id].x = line_number;
-               goal_positions[goal_pos_id].y = i;
-               goal_pos_id++;
-               break;              
-            case '@':
-               puzzle[line_number][i] = ' ';
-               current_pos.x = line_number;
-               current_pos.y = i;
-               break;
-            case '\n':
-               break;
-            default:
-               free(puzzle);
-               free(puzzle_temp);
-               free(boxes);
-               free(goal_positions);
-               char err_msg[30];
-               sprintf(err_msg, "Unknown character: %c\n", *ptr); 
-               err_exit(err_msg);
-               break;
-         }
-         i++;
-      }
-      
-      puzzle[line_number][i] = 0; 
-      puzzle_temp[line_number][i] = 0; 
-      line_number++;
-   }
+void free_search(Search *search) {
+   free_zobrist(&search->zobrist);
+   if (search->arena != NULL)
+      free_arena(search->arena);
+   if (search->table != NULL)
+      free_table(search->table);
+   if (search->states != NULL)
+      free_pqueue(search->states);
+   if (search->matching != NULL)
+      free_matching(search->matching);
+   free(search->cache.box_score);
+   free_deadlock(search);
+   free_patterns(search->patterns);
+   free_push(search);
+   free_spill(search);
+   free_symmetry(search);
+   free_corral(search);
+   free_macros(search);
+}
+
+// the settings of search and the buffers sized by the puzzle
+static int setup_search(Search *search, Level *level, Options *options) {
+   search->level = level;
+   search->verbose = options->verbose;
+   search->quiet = options->quiet;
+   search->stats.enabled = options->stats;
+   search->expand_func = options->push_mode ? make_push : make_move;
+   search->memory_limit = options->memory_limit;
+   search->deadline = (options->time_limit > 0) ? now_seconds() + options->time_limit : 0;
+   
+   if (init_heuristic(search, options->heuristic_func) ||
+      init_zobrist(&search->zobrist, level->height, level->width) ||
+      init_matching(&search->matching, level->num_boxes) ||
+      init_deadlock(search) ||
+      (options->push_mode && init_push(search)) ||
+      ((options->spill_dir != NULL) && init_spill(search, options->spill_dir)) ||
+      (options->symmetry && init_symmetry(search)) ||
+      (options->push_mode && options->corral_pruning && init_corral(search)) ||
+      (options->push_mode && options->macro_pushes && init_macros(search)))
+      return 1;
+   return 0;
+}
+
+int init_search(Search *search, Level *level, Options *options) {
+   memset(search, 0, sizeof(Search));
+   if (init_arena(&search->arena, STATE_SIZE(level->num_boxes)) ||
+      init_table(&search->table, 1024) ||
+      init_pqueue(&search->states, options->frontier_kind, options->tie_break) ||
+      init_patterns(&search->patterns))
+      return 1;
+   return setup_search(search, level, options);
+}
+
+int reset_search(Search *search, Level *level, Options *options) {
+   Arena *arena = search->arena;
+   Table *table = search->table;
+   PQueue *states = search->states;
+   struct patterns *patterns = search->patterns;
+   
+   free_zobrist(&search->zobrist);
+   if (search->matching != NULL)
+      free_matching(search->matching);
+   free(search->cache.box_score);
+   free_deadlock(search);
+   free_push(search);
+   free_spill(search);
+   free_symmetry(search);
+   free_corral(search);
+   free_macros(search);
+   
+   memset(search, 0, sizeof(Search));
+   reset_arena(arena, STATE_SIZE(level->num_boxes));
+   clear_table(table);
+   clear_pqueue(states);
+   search->arena = arena;
+   search->table = table;
+   search->states = states;
+   search->patterns = patterns;
+   return setup_search(search, level, options);
+}
+
+u_int add_root(Search *search, Coordinate start, Coordinate *boxes, uint64_t *root_hash) {
+   u_int num_boxes = search->level->num_boxes;
+   _Bool push_mode = (search->expand_func == make_push);
    
-   boxes = realloc(boxes, boxes_id*sizeof(Coordinate));
-   goal_positions = realloc(goal_positions, goal_pos_id*sizeof(Coordinate));
+   search->start = cell_index(search, start.x, start.y);
+   u_int root_id = alloc_arena(search->arena);
+   if (root_id == ARENA_NULL)
+      return NO_STATE;
    
-   State *root_state = malloc(sizeof(State));
-   root_state->parent = NULL;
+   State *root_state = get_state(search, root_id);
+   root_state->parent = NO_STATE;
    root_state->move_from_parent = 0;
-   root_state->boxes = boxes;
-   root_state->current_pos = &current_pos;
+   root_state->current_pos = search->start;
+   for (u_int i = 0; i < num_boxes; i++)
+      root_state->boxes[i] = cell_index(search, boxes[i].x, boxes[i].y);
+   if (push_mode) {
+      root_state->current_pos = normalize_cursor(search, search->start, root_state->boxes);
+      cell_coordinate(search, root_state->current_pos, &start);
+   }
    root_state->cost_score = 0;
-   root_state->heuristic_score = heuristic_funct(root_state->boxes, goal_positions, &current_pos, boxes_id);
-   
-   Queue *states, *history;
-   init_queue(&states);
-   init_queue(&history);
-   insert_head_queue(states, root_state);
-   
-   State *solution;
-   
-   if (NULL != (solution = search_solution(puzzle, puzzle_temp, states, history, goal_positions, boxes_id, heuristic_funct, line_number, verbose))) {
-
-      print_state(puzzle, solution, boxes_id, line_number);
+   root_state->heuristic_score = search->heuristic_func(search, boxes, push_mode ? NULL : &start);
+   
+   *root_hash = (search->symmetry != NULL) ? symmetric_hash(search, root_state->current_pos, root_state->boxes) :
+                                             hash_state(&search->zobrist, &start, boxes, num_boxes);
+   if (insert_pqueue(search->states, root_id, root_state->cost_score, root_state->heuristic_score) ||
+      insert_table(search->table, *root_hash, root_id))
+      return NO_STATE;
+   return root_id;
+}
 
-      char *out_str = malloc(sizeof(char) * (solution->cost_score*6 + 1));
-      out_str[0] = 0;
-      getSolution(solution, out_str);
+char *solution_moves(Search *search, u_int solution) {
+   if (search->expand_func == make_push)
+      return push_solution(search, solution);
+   
+   State *solution_state = get_state(search, solution);
+   char *out_str = malloc(sizeof(char) * (solution_state->cost_score*6 + 2));
+   if (out_str == NULL)
+      return NULL;
+   out_str[0] = 0;
+   getSolution(search, solution, out_str);
+   if (out_str[0] != 0)
       out_str[strlen(out_str)-1] = 0; // remove space at end
-      printf("%s\n", out_str);
-      free(out_str);
-      return 0;
-   }
-   
+   return out_str;
+}
+
+u_int count_moves(const char *moves) {
+   u_int length = (moves[0] != 0);
+   for (const char *ptr = moves; *ptr; ptr++)
+      length += (*ptr == ' ');
+   return length;
+}
+
+// the heuristics selectable on the command line
+static const struct {
+   const char *name;
+   u_int (*func)(Search *, Coordinate *, Coordinate *);
+   _Bool optimal;
+} heuristics[] = {
+   { "count_boxes", heuristic_count_boxes, True },
+   { "fixed_penalty", heuristic_fixed_penalty, True },
+   { "coarse_match", heuristic_coarse_match, False },
+   { "match_closest", heuristic_match_closest, True },
+   { "min_matching", heuristic_min_matching, True },
+};
+#define NUM_HEURISTICS (sizeof(heuristics) / sizeof(heuristics[0]))
+
+int set_heuristic(Options *options, const char *name) {
+   for (u_int i = 0; i < NUM_HEURISTICS; i++)
+      if (strcmp(heuristics[i].name, name) == 0) {
+         options->heuristic_func = heuristics[i].func;
+         return 0;
+      }
    return 1;
 }
+
+const char *heuristic_name(u_int (*func)(Search *, Coordinate *, Coordinate *)) {
+   for (u_int i = 0; i < NUM_HEURISTICS; i++)
+      if (heuristics[i].func == func)
+         return heuristics[i].name;
+   return "unknown";
+}
+
+_Bool optimal_heuristic(u_int (*func)(Search *, Coordinate *, Coordinate *)) {
+   for (u_int i = 0; i < NUM_HEURISTICS; i++)
+      if (heuristics[i].func == func)
+         return heuristics[i].optimal;
+   return False;
+}
+
+_Bool optimal_search(Options *options) {
+   return !options->bidir_mode && (options->beam_width == 0) && (options->anytime_weight == 0) &&
+          !options->macro_pushes && optimal_heuristic(options->heuristic_func);
+}
+
+void default_options(Options *options) {
+   memset(options, 0, sizeof(Options));
+   options->heuristic_func = heuristic_fixed_penalty;
+   options->frontier_kind = PQ_BUCKET;
+   options->tie_break = PQ_TIE_LOW_H;
+   options->verbose = True;
+   options->num_threads = 1;
+   options->table_mb = IDA_DEFAULT_TABLE_MB;
+}
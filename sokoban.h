@@ -0,0 +1,260 @@
+#ifndef SOKOBAN_H
+#define SOKOBAN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include "types.h"
+#include "table.h"
+#include "pqueue.h"
+#include "arena.h"
+#include "level.h"
+#include "matching.h"
+#include "stats.h"
+
+#define True 1
+#define False 0
+
+#define NO_STATE UINT_MAX
+#define HEURISTIC_DEAD UINT_MAX  // heuristic score of a state that can never be solved
+#define NO_BOX UINT_MAX
+
+// reasons for search_solution to give up before the frontier is exhausted
+#define SEARCH_RUNNING 0
+#define SEARCH_TIME_LIMIT 1
+#define SEARCH_MEMORY_LIMIT 2
+#define SEARCH_OUT_OF_MEMORY 3
+#define LIMIT_CHECK_INTERVAL 1024  // nodes expanded between two checks of the limits
+
+// Lightweight state, only boxes positions and cursor position are stored.
+// States are fixed stride records in an arena: positions are cell indices (x*width + y)
+// and the parent is referenced by its arena index, and by the thread owning that arena
+// in the parallel search (see hda.c)
+typedef struct {
+   u_int parent;
+   u_int cost_score;
+   u_int heuristic_score;
+   u_short current_pos;
+   u_char move_from_parent;
+   u_char parent_thread;
+   u_short boxes[];
+} State;
+
+// move_from_parent holds the move direction in its low bits, and above them the symmetry taking
+// the child reached by the move to the stored state (see symmetry.c)
+#define MOVE_BITS 2
+#define MOVE_MASK ((1 << MOVE_BITS) - 1)
+
+#define STATE_SIZE(num_boxes) ((sizeof(State) + sizeof(u_short) * (num_boxes) + 3) & ~3U)
+
+// random keys for the incremental (zobrist) hashing of the states.
+// a state hash is the xor of the cursor key of its cursor cell and the box keys of all its box cells,
+// so a child hash is derived from its parent by xoring out the old cells and xoring in the new ones
+typedef struct {
+   uint64_t *boxes;
+   uint64_t *cursor;
+   u_int width;
+} Zobrist;
+
+// per box terms of the heuristic score of the state being expanded. its children differ from it by
+// one box at most, so they are scored from these without going over every box again (see child_heuristic)
+typedef struct {
+   u_int state;            // id of the state the terms belong to, NO_STATE outside of an expansion
+   u_int moved_box;        // box pushed to reach the child being scored, NO_BOX if only the cursor moved
+   u_int *box_score;       // minimum push distance of each box
+   u_int total;            // sum of box_score
+   u_int off_goal;         // boxes with a box_score above 0
+   u_int closest[2];       // the two off goal boxes of lowest box_score, lowest index first, NO_BOX if none
+} HeuristicCache;
+
+// everything needed by the search: the puzzle description and the containers holding the states
+typedef struct search {
+   Level *level;
+   u_int (*heuristic_func)(struct search *, Coordinate *, Coordinate *);
+   u_int (*heuristic_update)(struct search *, Coordinate *, Coordinate *);  // NULL if not incremental
+   HeuristicCache cache;
+   _Bool verbose;
+   int (*expand_func)(struct search *, u_int);   // make_move or make_push
+   u_short start;          // cursor cell of the puzzle as given, states may hold a normalized one
+   _Bool quiet;            // don't report the number of nodes when a solution is found
+   unsigned long nodes;    // states expanded so far
+   double deadline;        // now_seconds() value to stop at, 0 for no time limit
+   size_t memory_limit;    // bytes the containers may hold, 0 for no limit
+   u_char stopped;         // SEARCH_RUNNING or the limit that stopped the search
+   Stats stats;
+   Zobrist zobrist;
+   Arena *arena;           // every state generated, the index of a state is its id
+   Table *table;           // every state generated, for duplicate detection
+   PQueue *states;         // states waiting to be expanded
+   Matching *matching;     // assignment kept between calls of the min_matching heuristic
+   
+   // deadlock detection, indexed by cell (see deadlock.c)
+   u_char *box_map;        // box id + 1 of the box on a cell of the expanded state, 0 for no box
+   u_char *chain;
+   unsigned long freeze_pruned;
+   struct patterns *patterns; // windows proven dead or alive so far (see pattern.c)
+   struct corral *corral;  // push mode only, NULL when every push is made (see corral.c)
+   struct macros *macros;  // push mode only, NULL when every push makes its own child (see macro.c)
+   
+   // parallel search, NULL when searching alone (see hda.c)
+   struct hda *hda;
+   u_char thread;          // index of the thread running this search
+   
+   // iterative deepening search, NULL for A* (see ida.c)
+   struct ida *ida;
+   
+   // bidirectional search, NULL when searching forward only (see bidir.c)
+   struct bidir *bidir;
+   
+   // anytime search, NULL for a single unweighted pass (see ara.c)
+   struct ara *ara;
+   
+   // beam search, NULL when every child is kept (see beam.c)
+   struct beam *beam;
+   
+   // states written to disk once over the memory limit, NULL when the search stops there (see spill.c)
+   struct spill *spill;
+   
+   // rotations and mirrors of the level, NULL when states are told apart as they are (see symmetry.c)
+   struct symmetry *symmetry;
+   
+   // push mode scratch buffers, indexed by cell (see push.c)
+   u_int *reach;
+   u_int *visited;
+   u_int stamp;
+   u_short *cell_queue;
+   u_char *came_from;
+} Search;
+
+// settings shared by every puzzle solved by one run of the program
+typedef struct {
+   u_int (*heuristic_func)(Search *, Coordinate *, Coordinate *);
+   u_char frontier_kind;
+   u_char tie_break;
+   _Bool push_mode;
+   _Bool verbose;
+   _Bool stats;            // time the phases of the search for --stats
+   double time_limit;      // seconds per puzzle, 0 for no limit
+   size_t memory_limit;    // bytes per puzzle, 0 for no limit
+   char *spill_dir;        // where states go over the memory limit, NULL to give up instead
+   double anytime_weight;  // first weight on the heuristic of the anytime search, 0 for plain A*
+   char *cache_file;       // optimal solutions kept across runs, NULL for none (see cache.c)
+   _Bool quiet;            // don't report the progress of the search
+   _Bool ida_mode;         // iterative deepening search (see ida.c)
+   _Bool bidir_mode;       // push forward and pull backward until they meet (see bidir.c)
+   u_int num_threads;      // threads of the parallel search (see hda.c), 1 to search alone
+   u_int table_mb;         // transposition table size of the iterative deepening search
+   u_int beam_width;       // states kept per depth by the beam search (see beam.c), 0 for no beam
+   _Bool symmetry;         // keep one of the states that are rotations or mirrors of each other (see symmetry.c), A* only
+   _Bool corral_pruning;   // make only the pushes of a PI-corral when there is one, push mode only (see corral.c)
+   _Bool macro_pushes;     // push boxes through tunnels and into goal rooms in one go, push mode only (see macro.c)
+} Options;
+
+// key used to look up a candidate state in the state table without allocating it first
+typedef struct {
+   Search *search;
+   u_short current_pos;
+   u_short *boxes;
+} StateKey;
+
+// cell offsets of the four moves, in the order up, down, left, right
+#define MOVE_OFFSETS(width) { -(int) (width), (int) (width), -1, 1 }
+
+// prints msg and exits, for the command line front end only (see main.c)
+void err_exit(char *msg);
+
+uint64_t next_random(uint64_t *seed);
+
+// seconds on a monotonic clock
+double now_seconds(void);
+
+// the settings of the command line without any argument
+void default_options(Options *options);
+
+// selects the heuristic called name on the command line, returns 1 if there is none
+int set_heuristic(Options *options, const char *name);
+
+int init_search(Search *search, Level *level, Options *options);
+
+// prepares a search made by init_search for another puzzle, keeping the allocations of its state arena,
+// state table and frontier, and the patterns learned. options must keep the frontier kind and tie breaking
+int reset_search(Search *search, Level *level, Options *options);
+
+// sets func as the heuristic of search, along with its incremental form if it has one
+int init_heuristic(Search *search, u_int (*func)(Search *, Coordinate *, Coordinate *));
+
+// fills the cache with the terms of the state being expanded, boxes are its boxes
+void prepare_heuristic(Search *search, u_int state_id, Coordinate *boxes);
+
+// heuristic score of a child of parent_id, from the cache when it holds the terms of parent_id
+u_int child_heuristic(Search *search, u_int parent_id, Coordinate *boxes, Coordinate *cursor);
+
+// stores the initial state of the puzzle and returns its id, NO_STATE if out of memory
+u_int add_root(Search *search, Coordinate start, Coordinate *boxes, uint64_t *root_hash);
+
+// sets stopped when the search ran past its deadline or its containers grew past the memory limit
+_Bool over_limits(Search *search);
+
+// best first search from the states in the frontier, returns the solution or NO_STATE
+u_int search_solution(Search *search);
+
+// move sequence of a solution separated by spaces, the caller frees it
+char *solution_moves(Search *search, u_int solution);
+
+// number of moves in a move sequence made by solution_moves
+u_int count_moves(const char *moves);
+
+void free_search(Search *search);
+
+uint64_t zobrist_box(Zobrist *zobrist, int x, int y);
+
+uint64_t zobrist_cursor(Zobrist *zobrist, int x, int y);
+
+uint64_t hash_state(Zobrist *zobrist, Coordinate *cursor, Coordinate *boxes, u_int num_boxes);
+
+State *get_state(Search *search, u_int id);
+
+// equals function of the state table, state_key is a StateKey
+int equal_state(u_int stored_state, void *state_key);
+
+// id of the state stored with the same boxes and cursor, NO_STATE if there is none
+u_int get_duplicate(Search *search, uint64_t hash, u_short new_cursor_pos, u_short *new_boxes);
+
+u_short cell_index(Search *search, int x, int y);
+
+void cell_coordinate(Search *search, u_short cell, Coordinate *pos);
+
+void unpack_state(Search *search, State *state, Coordinate *cursor, Coordinate *boxes);
+
+void print_state(Search *search, State *sol);
+
+const char *move_name(u_char move);
+
+// name of the heuristic on the command line
+const char *heuristic_name(u_int (*func)(Search *, Coordinate *, Coordinate *));
+
+// whether the heuristic never overestimates, so that the A* searches find optimal solutions with it
+_Bool optimal_heuristic(u_int (*func)(Search *, Coordinate *, Coordinate *));
+
+// whether the search the options ask for proves its solutions optimal, only those fill the solution cache
+_Bool optimal_search(Options *options);
+
+// stores the child reached by move from parent_id in thread parent_thread with cost moves, unless it is a duplicate
+int insert_child(Search *search, u_int parent_id, u_char parent_thread, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+// adds the child of parent_id reached by move, made steps times, unless it is a duplicate (see make_move)
+int add_child(Search *search, u_int parent_id, u_char move, u_int steps, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+// keeps the child for the depth first search of the iterative deepening mode (see ida.c)
+int collect_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+// stores the child and checks whether the search from the other end has it (see bidir.c)
+int meet_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+// keeps the child as a candidate for the next depth of the beam search (see beam.c)
+int beam_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+// hands the child to the thread owning it in the parallel search (see hda.c)
+int send_child(Search *search, u_int parent_id, u_int cost, u_char move, uint64_t hash, u_short cursor, u_short *cells, Coordinate *cursor_pos, Coordinate *boxes);
+
+#endif
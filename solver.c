@@ -0,0 +1,243 @@
+/*
+ * solver.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Solver context, the library interface of the solver. The command line (main.c) is a front end over it.
+ * 
+ * The context owns the puzzle and the search. The first puzzle sets the search up with init_search,
+ * later ones with reset_search, which keeps the blocks of the state arena and the arrays of the state
+ * table and frontier at the size the largest puzzle so far grew them to, so that a long lived process
+ * solving puzzle after puzzle doesn't allocate them again. Errors are returned, nothing exits.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+#include "pattern.h"
+#include "hda.h"
+#include "ida.h"
+#include "bidir.h"
+#include "ara.h"
+#include "beam.h"
+#include "cache.h"
+
+#define SOLVER_ERROR_SIZE 256  // room for the file names in the warnings
+
+struct solver {
+   Options options;
+   Patterns *patterns;     // the same as search.patterns once the search is set up
+   
+   Level level;
+   Coordinate start;
+   Coordinate *boxes;
+   _Bool has_level;
+   
+   Search search;
+   _Bool has_search;
+   u_int solution;         // NO_STATE if the last puzzle wasn't solved by a search
+   double seconds;         // time taken by the last search
+   
+   char *moves;
+   CacheHit hit;           // hit.moves is moves when the solution came from the cache
+   _Bool cached;
+   char error[SOLVER_ERROR_SIZE];
+};
+
+int init_solver(Solver **ptr, Options *options) {
+   *ptr = calloc(1, sizeof(Solver));
+   if (*ptr == NULL)
+      return 1;
+   
+   (*ptr)->options = *options;
+   (*ptr)->solution = NO_STATE;
+   if (init_patterns(&(*ptr)->patterns)) {
+      free(*ptr);
+      return 1;
+   }
+   return 0;
+}
+
+// drops the puzzle and the solution of the last solve, the search is kept
+static void release_puzzle(Solver *solver) {
+   if (solver->has_level) {
+      free_level(&solver->level);
+      free(solver->boxes);
+   }
+   free(solver->moves);
+   solver->has_level = False;
+   solver->moves = NULL;
+   solver->cached = False;
+   solver->solution = NO_STATE;
+   solver->seconds = 0;
+   solver->error[0] = 0;
+}
+
+static int prepare_search(Solver *solver) {
+   Search *search = &solver->search;
+   if (solver->has_search)
+      return reset_search(search, &solver->level, &solver->options);
+   
+   if (init_search(search, &solver->level, &solver->options)) {
+      free_search(search);
+      return 1;
+   }
+   free_patterns(search->patterns);
+   search->patterns = solver->patterns;
+   solver->has_search = True;
+   return 0;
+}
+
+// the search given by the options from the root, returns the solution or NO_STATE
+static u_int run_search(Solver *solver, u_int root_id, uint64_t root_hash) {
+   Search *search = &solver->search;
+   Options *options = &solver->options;
+   
+   if (options->ida_mode)
+      return ida_search(search, root_id, root_hash, options->table_mb);
+   if (options->beam_width > 0)
+      return beam_search(search, root_id, root_hash, options->beam_width);
+   if (options->bidir_mode)
+      return bidir_search(search, root_id, root_hash);
+   if (options->num_threads > 1)
+      return hda_search(search, root_id, root_hash, options->num_threads);
+   if (options->anytime_weight > 0)
+      return ara_search(search, options->anytime_weight);
+   return search_solution(search);
+}
+
+// only the searches that prove their solutions optimal fill the cache
+static void store_solution(Solver *solver) {
+   Options *options = &solver->options;
+   const char *mode = options->ida_mode ? "IDA*" : ((options->num_threads > 1) ? "HDA*" : "A*");
+   
+   if (!optimal_search(options))
+      return;
+   if (store_cached(options->cache_file, &solver->level, solver->start, solver->boxes, options->push_mode,
+                    solver->moves, heuristic_name(options->heuristic_func), mode))
+      snprintf(solver->error, SOLVER_ERROR_SIZE, "Could not write solution cache %s", options->cache_file);
+}
+
+int solve_puzzle(Solver *solver, const char *text, size_t length) {
+   Options *options = &solver->options;
+   LevelFile file = { text, length, 0, False };
+   
+   release_puzzle(solver);
+   switch (read_level(&file, &solver->level, &solver->start, &solver->boxes, solver->error)) {
+      case (LEVEL_END):
+         strcpy(solver->error, "Incorrect format of file");
+         return SOLVER_INVALID;
+      case (LEVEL_INVALID):
+         return SOLVER_INVALID;
+   }
+   solver->has_level = True;
+   
+   if ((options->cache_file != NULL) &&
+      find_cached(options->cache_file, &solver->level, solver->start, solver->boxes, options->push_mode, &solver->hit)) {
+      solver->moves = solver->hit.moves;
+      solver->cached = True;
+      return SOLVER_SOLVED;
+   }
+   
+   Search *search = &solver->search;
+   if (prepare_search(solver))
+      return SOLVER_NO_MEMORY;
+   
+   double started = now_seconds();
+   uint64_t root_hash;
+   u_int root_id = add_root(search, solver->start, solver->boxes, &root_hash);
+   if (root_id == NO_STATE)
+      return SOLVER_NO_MEMORY;
+   if (get_state(search, root_id)->heuristic_score != HEURISTIC_DEAD)
+      solver->solution = run_search(solver, root_id, root_hash);
+   solver->seconds = now_seconds() - started;
+   
+   if (search->stopped == SEARCH_OUT_OF_MEMORY)
+      return SOLVER_NO_MEMORY;
+   if (!options->quiet && (search->stopped == SEARCH_TIME_LIMIT))
+      fprintf(stderr, "Time limit reached\n");
+   if (!options->quiet && (search->stopped == SEARCH_MEMORY_LIMIT))
+      fprintf(stderr, "Memory limit reached\n");
+   
+   if (solver->solution == NO_STATE) {
+      if (search->stopped == SEARCH_TIME_LIMIT)
+         return SOLVER_TIME_LIMIT;
+      if (search->stopped == SEARCH_MEMORY_LIMIT)
+         return SOLVER_MEMORY_LIMIT;
+      return SOLVER_UNSOLVABLE;
+   }
+   
+   if (NULL == (solver->moves = solution_moves(search, solver->solution)))
+      return SOLVER_NO_MEMORY;
+   if (options->cache_file != NULL)
+      store_solution(solver);
+   return SOLVER_SOLVED;
+}
+
+const char *solver_moves(Solver *solver) {
+   return solver->moves;
+}
+
+unsigned long solver_nodes(Solver *solver) {
+   return (solver->has_level && solver->has_search && !solver->cached) ? solver->search.nodes : 0;
+}
+
+const char *solver_error(Solver *solver) {
+   return solver->error;
+}
+
+void print_solution(Solver *solver) {
+   if (solver->moves == NULL)
+      return;
+   if (solver->cached)
+      fprintf(stderr, "Cached solution of cost %u, found by %s with %s\n", solver->hit.cost, solver->hit.mode,
+              solver->hit.heuristic);
+   else
+      print_state(&solver->search, get_state(&solver->search, solver->solution));
+   printf("%s\n", solver->moves);
+}
+
+void print_solver_stats(Solver *solver, FILE *file, const char *name) {
+   if (solver->has_search && !solver->cached)
+      print_stats(file, &solver->search.stats, name, (solver->moves == NULL) ? 0 : count_moves(solver->moves),
+                  solver->seconds);
+}
+
+int load_solver_patterns(Solver *solver, const char *filename) {
+   return load_patterns(solver->patterns, filename);
+}
+
+int save_solver_patterns(Solver *solver, const char *filename) {
+   return save_patterns(solver->patterns, filename);
+}
+
+int import_solver_patterns(Solver *solver, Patterns *from) {
+   return merge_patterns(solver->patterns, from);
+}
+
+int export_solver_patterns(Solver *solver, Patterns *into) {
+   return merge_patterns(into, solver->patterns);
+}
+
+void free_solver(Solver *solver) {
+   release_puzzle(solver);
+   if (solver->has_search)
+      free_search(&solver->search);
+   else
+      free_patterns(solver->patterns);
+   free(solver);
+}
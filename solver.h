@@ -0,0 +1,53 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdio.h>
+#include "sokoban.h"
+
+// return codes of solve_puzzle
+#define SOLVER_SOLVED 0
+#define SOLVER_UNSOLVABLE 1     // every state reachable was searched
+#define SOLVER_INVALID 2        // the puzzle can't be read, the reason is given by solver_error
+#define SOLVER_NO_MEMORY 3
+#define SOLVER_TIME_LIMIT 4
+#define SOLVER_MEMORY_LIMIT 5
+
+// a solver context, solving puzzles one after the other with the same options. the state arena, state
+// table and frontier of a puzzle are kept for the next one, and so are the deadlock patterns learned
+typedef struct solver Solver;
+
+// options are copied
+int init_solver(Solver **ptr, Options *options);
+
+// solves the first puzzle of the length bytes of text, in any format read_level accepts
+int solve_puzzle(Solver *solver, const char *text, size_t length);
+
+// moves of the last solution separated by spaces, valid until the next solve_puzzle
+const char *solver_moves(Solver *solver);
+
+// nodes expanded by the last search, 0 if the puzzle was answered from the cache
+unsigned long solver_nodes(Solver *solver);
+
+// reason of the last SOLVER_INVALID, or a warning after a solve, empty if none
+const char *solver_error(Solver *solver);
+
+// prints the last solution like the command line does, the board solved and the moves on stdout, or
+// the solution cache entry it was taken from on stderr and the moves
+void print_solution(Solver *solver);
+
+// prints the statistics of the last search (see stats.h) under name, which may be NULL, nothing if it was
+// answered from the cache
+void print_solver_stats(Solver *solver, FILE *file, const char *name);
+
+// merges the deadlock patterns of filename into the ones of the solver, returns 1 on a read error
+int load_solver_patterns(Solver *solver, const char *filename);
+
+int save_solver_patterns(Solver *solver, const char *filename);
+
+// adds the deadlock patterns of from that the solver doesn't know yet, and the other way around
+int import_solver_patterns(Solver *solver, struct patterns *from);
+int export_solver_patterns(Solver *solver, struct patterns *into);
+
+void free_solver(Solver *solver);
+
+#endif
@@ -0,0 +1,532 @@
+/*
+ * spill.c Copyright (C) 2019 Orpheas van Rooij
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Memory bounded A*: once the states of the search take more than the memory limit, all of them
+ * are written to disk and the search starts over from the best part of the frontier.
+ *
+ * Every state written goes to the seen file, sorted by state and holding the cheapest copy of each,
+ * together with the hash of its parent so that solution paths can be followed back through it.
+ * The frontier states not kept in memory go to runs, files sorted by f. Whenever the best state of
+ * the runs is better than the best one of the in-memory frontier, a batch of states is merged back.
+ *
+ * Duplicates are detected late: a state coming back from a run is dropped if the seen file has it
+ * at a lower cost, and a state generated in memory is dropped when it is removed from the frontier if
+ * the seen file has it at no higher cost. States brought back from disk have no parent in memory,
+ * their path continues in the seen file.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // mkstemp, fdopen, pread
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spill.h"
+
+#define RECORD(base, size, i) ((SpillRecord *) ((u_char *) (base) + (size_t) (i) * (size)))
+
+// records waiting to be sorted and written
+typedef struct {
+   SpillRecord *records;
+   u_int length;
+   u_int capacity;
+} Chunk;
+
+static int compare_states(const SpillRecord *a, const SpillRecord *b) {
+   if (a->hash != b->hash)
+      return (a->hash < b->hash) ? -1 : 1;
+   if (a->cursor != b->cursor)
+      return (a->cursor < b->cursor) ? -1 : 1;
+   for (u_int i = 0; i < a->num_boxes; i++)
+      if (a->boxes[i] != b->boxes[i])
+         return (a->boxes[i] < b->boxes[i]) ? -1 : 1;
+   return 0;
+}
+
+// order of the seen file: by state, the cheapest copy of a state first
+static int compare_seen(const void *a, const void *b) {
+   const SpillRecord *x = a, *y = b;
+   int order = compare_states(x, y);
+   if (order != 0)
+      return order;
+   return (x->cost < y->cost) ? -1 : (x->cost > y->cost);
+}
+
+// order of the runs: by f, then closest to the goal first
+static int compare_frontier(const void *a, const void *b) {
+   const SpillRecord *x = a, *y = b;
+   u_int fx = x->cost + x->heuristic;
+   u_int fy = y->cost + y->heuristic;
+   if (fx != fy)
+      return (fx < fy) ? -1 : 1;
+   return (x->heuristic < y->heuristic) ? -1 : (x->heuristic > y->heuristic);
+}
+
+// a new file in the spill directory, deleted right away so that nothing is left behind
+static FILE *new_file(Spill *spill) {
+   char path[strlen(spill->dir) + 32];
+   sprintf(path, "%s/sokoban-spill-XXXXXX", spill->dir);
+   
+   int fd = mkstemp(path);
+   if (fd < 0)
+      return NULL;
+   unlink(path);
+   
+   FILE *file = fdopen(fd, "w+b");
+   if (file == NULL)
+      close(fd);
+   return file;
+}
+
+static uint64_t state_hash(Search *search, State *state) {
+   u_int num_boxes = search->level->num_boxes;
+   Coordinate cursor;
+   Coordinate boxes[num_boxes];
+   unpack_state(search, state, &cursor, boxes);
+   return hash_state(&search->zobrist, &cursor, boxes, num_boxes);
+}
+
+static void make_record(Search *search, State *state, uint64_t hash, SpillRecord *rec) {
+   u_int num_boxes = search->level->num_boxes;
+   
+   memset(rec, 0, search->spill->record_size);
+   rec->hash = hash;
+   rec->cost = state->cost_score;
+   rec->heuristic = state->heuristic_score;
+   rec->cursor = state->current_pos;
+   rec->num_boxes = num_boxes;
+   rec->move = state->move_from_parent;
+   
+   for (u_int i = 0; i < num_boxes; i++) {
+      u_int j = i;
+      for (; (j > 0) && (rec->boxes[j-1] > state->boxes[i]); j--)
+         rec->boxes[j] = rec->boxes[j-1];
+      rec->boxes[j] = state->boxes[i];
+   }
+}
+
+static _Bool read_record(Spill *spill, Run *run) {
+   if (fread(run->head, spill->record_size, 1, run->file) == 1)
+      return True;
+   fclose(run->file);
+   free(run->head);
+   run->file = NULL;
+   run->head = NULL;
+   return False;
+}
+
+// sorts the records of chunk and writes them to a new file, rewound for reading
+static FILE *write_chunk(Spill *spill, Chunk *chunk, int (*compare)(const void *, const void *)) {
+   qsort(chunk->records, chunk->length, spill->record_size, compare);
+   
+   FILE *file = new_file(spill);
+   if ((file == NULL) || (fwrite(chunk->records, spill->record_size, chunk->length, file) != chunk->length)) {
+      if (file != NULL)
+         fclose(file);
+      return NULL;
+   }
+   rewind(file);
+   chunk->length = 0;
+   return file;
+}
+
+static int add_run(Spill *spill, Chunk *chunk) {
+   if (spill->num_runs == spill->runs_capacity) {
+      spill->runs_capacity = spill->runs_capacity ? spill->runs_capacity * 2 : 16;
+      Run *runs = realloc(spill->runs, sizeof(Run) * spill->runs_capacity);
+      if (runs == NULL)
+         return 1;
+      spill->runs = runs;
+   }
+   
+   Run *run = &spill->runs[spill->num_runs];
+   if ((NULL == (run->file = write_chunk(spill, chunk, compare_frontier))) ||
+      (NULL == (run->head = malloc(spill->record_size))))
+      return 1;
+   if (read_record(spill, run))
+      spill->num_runs++;
+   return 0;
+}
+
+// merges the sorted files into a new seen file together with the current one, keeping one copy of each state
+static int merge_seen(Spill *spill, FILE **files, u_int num_files) {
+   u_int num_inputs = num_files + (spill->seen != NULL);
+   Run inputs[num_inputs];
+   
+   for (u_int i = 0; i < num_files; i++)
+      inputs[i].file = files[i];
+   if (spill->seen != NULL) {
+      rewind(spill->seen);
+      inputs[num_files].file = spill->seen;
+   }
+   for (u_int i = 0; i < num_inputs; i++)
+      if ((NULL == (inputs[i].head = malloc(spill->record_size))))
+         return 1;
+   for (u_int i = 0; i < num_inputs; i++)
+      read_record(spill, &inputs[i]);
+   
+   FILE *seen = new_file(spill);
+   SpillRecord *last = spill->scratch;
+   if (seen == NULL)
+      return 1;
+   
+   unsigned long length = 0;
+   for (;;) {
+      Run *best = NULL;
+      for (u_int i = 0; i < num_inputs; i++)
+         if ((inputs[i].head != NULL) && ((best == NULL) || (compare_seen(inputs[i].head, best->head) < 0)))
+            best = &inputs[i];
+      if (best == NULL)
+         break;
+   
+      if ((length == 0) || (compare_states(last, best->head) != 0)) {
+         if (fwrite(best->head, spill->record_size, 1, seen) != 1)
+            return 1;
+         memcpy(last, best->head, spill->record_size);
+         length++;
+      }
+      read_record(spill, best);
+   }
+   
+   if (fflush(seen))
+      return 1;
+   spill->seen = seen;
+   spill->seen_length = length;
+   return 0;
+}
+
+// binary search of the seen file for the state of key, or for its hash alone
+static _Bool find_seen(Spill *spill, SpillRecord *key, _Bool hash_only, SpillRecord *found) {
+   int fd = fileno(spill->seen);
+   unsigned long low = 0, high = spill->seen_length;
+   
+   while (low < high) {
+      unsigned long middle = low + (high - low) / 2;
+      if (pread(fd, found, spill->record_size, (off_t) middle * spill->record_size) != (ssize_t) spill->record_size)
+         return False;
+   
+      _Bool before = hash_only ? (found->hash < key->hash) : (compare_states(found, key) < 0);
+      if (before)
+         low = middle + 1;
+      else
+         high = middle;
+   }
+   
+   if ((low == spill->seen_length) ||
+      (pread(fd, found, spill->record_size, (off_t) low * spill->record_size) != (ssize_t) spill->record_size))
+      return False;
+   return hash_only ? (found->hash == key->hash) : (compare_states(found, key) == 0);
+}
+
+// puts a state from disk in the frontier, its path continues on disk
+static int materialize(Search *search, SpillRecord *rec) {
+   u_int identical = get_duplicate(search, rec->hash, rec->cursor, rec->boxes);
+   if (identical != NO_STATE) {
+      State *state = get_state(search, identical);
+      if (state->cost_score <= rec->cost) {
+         search->spill->dropped++;
+         return 0;
+      }
+      state->parent = NO_STATE;
+      state->move_from_parent = rec->move;
+      state->cost_score = rec->cost;
+      if (contains_pqueue(search->states, identical))
+         return update_pqueue(search->states, identical, state->cost_score, state->heuristic_score);
+      return insert_pqueue(search->states, identical, state->cost_score, state->heuristic_score);
+   }
+   
+   u_int new_id = alloc_arena(search->arena);
+   if (new_id == ARENA_NULL)
+      return 1;
+   
+   State *state = get_state(search, new_id);
+   state->parent = NO_STATE;
+   state->parent_thread = 0;
+   state->move_from_parent = rec->move;
+   state->current_pos = rec->cursor;
+   memcpy(state->boxes, rec->boxes, sizeof(u_short) * rec->num_boxes);
+   state->cost_score = rec->cost;
+   state->heuristic_score = rec->heuristic;
+   
+   if (insert_pqueue(search->states, new_id, state->cost_score, state->heuristic_score) ||
+      insert_table(search->table, rec->hash, new_id))
+      return 1;
+   return 0;
+}
+
+static void append_chunk(Chunk *chunk, SpillRecord *rec, u_int size) {
+   memcpy(RECORD(chunk->records, size, chunk->length), rec, size);
+   chunk->length++;
+}
+
+int spill_states(Search *search) {
+   Spill *spill = search->spill;
+   PQueue *frontier = search->states;
+   u_int num_states = search->arena->length;
+   u_int size = spill->record_size;
+   
+   // the frontier states of f up to keep_f stay in memory, as many as fit in a part of the limit
+   size_t used = size_arena(search->arena) + size_table(search->table) + size_pqueue(frontier);
+   unsigned long keep = search->memory_limit / SPILL_KEEP_FRACTION / (used / num_states + 1);
+   u_int max_f = 0;
+   for (u_int id = 0; id < num_states; id++)
+      if (contains_pqueue(frontier, id)) {
+         State *state = get_state(search, id);
+         if (state->cost_score + state->heuristic_score > max_f)
+            max_f = state->cost_score + state->heuristic_score;
+      }
+   unsigned long *counts = calloc(max_f + 1, sizeof(unsigned long));
+   if (counts == NULL)
+      return 1;
+   for (u_int id = 0; id < num_states; id++)
+      if (contains_pqueue(frontier, id)) {
+         State *state = get_state(search, id);
+         counts[state->cost_score + state->heuristic_score]++;
+      }
+   long keep_f = -1;
+   unsigned long num_kept = 0;
+   for (u_int f = 0; (f <= max_f) && (num_kept + counts[f] <= keep); f++) {
+      num_kept += counts[f];
+      keep_f = f;
+   }
+   free(counts);
+   
+   u_int chunk_capacity = search->memory_limit / SPILL_CHUNK_FRACTION / size;
+   if (chunk_capacity < 1024)
+      chunk_capacity = 1024;
+   Chunk seen_chunk = { malloc((size_t) size * chunk_capacity), 0, chunk_capacity };
+   Chunk frontier_chunk = { malloc((size_t) size * chunk_capacity), 0, chunk_capacity };
+   SpillRecord *kept = malloc((size_t) size * (num_kept + 1));
+   FILE **seen_files = NULL;
+   u_int num_seen_files = 0;
+   if ((seen_chunk.records == NULL) || (frontier_chunk.records == NULL) || (kept == NULL))
+      return 1;
+   
+   SpillRecord *rec = RECORD(spill->scratch, size, 1);
+   num_kept = 0;
+   for (u_int id = 0; id < num_states; id++) {
+      State *state = get_state(search, id);
+      _Bool open = contains_pqueue(frontier, id);
+      _Bool from_disk = (state->parent == NO_STATE) && (state->cost_score > 0);
+      if (from_disk && !open)
+         continue;   // the seen file has it already
+   
+      make_record(search, state, state_hash(search, state), rec);
+      if (state->parent != NO_STATE)
+         rec->parent_hash = state_hash(search, get_state(search, state->parent));
+      rec->root = (state->parent == NO_STATE) && (state->cost_score == 0);
+   
+      if (!from_disk) {
+         append_chunk(&seen_chunk, rec, size);
+         spill->written++;
+         if (seen_chunk.length == seen_chunk.capacity) {
+            FILE **files = realloc(seen_files, sizeof(FILE *) * (num_seen_files + 1));
+            if ((files == NULL) || (NULL == (files[num_seen_files] = write_chunk(spill, &seen_chunk, compare_seen))))
+               return 1;
+            seen_files = files;
+            num_seen_files++;
+         }
+      }
+      if (open && ((long) (state->cost_score + state->heuristic_score) <= keep_f))
+         memcpy(RECORD(kept, size, num_kept++), rec, size);
+      else if (open) {
+         append_chunk(&frontier_chunk, rec, size);
+         if ((frontier_chunk.length == frontier_chunk.capacity) && add_run(spill, &frontier_chunk))
+            return 1;
+      }
+   }
+   if (seen_chunk.length > 0) {
+      FILE **files = realloc(seen_files, sizeof(FILE *) * (num_seen_files + 1));
+      if ((files == NULL) || (NULL == (files[num_seen_files] = write_chunk(spill, &seen_chunk, compare_seen))))
+         return 1;
+      seen_files = files;
+      num_seen_files++;
+   }
+   if ((frontier_chunk.length > 0) && add_run(spill, &frontier_chunk))
+      return 1;
+   free(seen_chunk.records);
+   free(frontier_chunk.records);
+   
+   if (merge_seen(spill, seen_files, num_seen_files))
+      return 1;
+   free(seen_files);
+   
+   // start over from the kept part of the frontier
+   u_int stride = search->arena->stride;
+   u_char kind = frontier->kind;
+   u_char tie_break = frontier->tie_break;
+   free_arena(search->arena);
+   free_table(search->table);
+   free_pqueue(search->states);
+   if (init_arena(&search->arena, stride) ||
+      init_table(&search->table, 1024) ||
+      init_pqueue(&search->states, kind, tie_break))
+      return 1;
+   
+   for (u_int i = 0; i < num_kept; i++)
+      if (materialize(search, RECORD(kept, size, i)))
+         return 1;
+   free(kept);
+   
+   spill->spills++;
+   return 0;
+}
+
+int refill_frontier(Search *search) {
+   Spill *spill = search->spill;
+   SpillRecord *found = RECORD(spill->scratch, spill->record_size, 1);
+   
+   for (u_int loaded = 0; loaded < SPILL_LOAD_BATCH; loaded++) {
+      Run *best = NULL;
+      for (u_int i = 0; i < spill->num_runs; i++)
+         if ((best == NULL) || (compare_frontier(spill->runs[i].head, best->head) < 0))
+            best = &spill->runs[i];
+      if (best == NULL)
+         break;
+   
+      // ties go to the states in memory
+      u_int best_f = best->head->cost + best->head->heuristic;
+      u_int frontier_f = min_key_pqueue(search->states);
+      if ((frontier_f != PQ_ABSENT) && ((best_f > frontier_f) || ((loaded == 0) && (best_f == frontier_f))))
+         break;
+   
+      SpillRecord *rec = best->head;
+      if (find_seen(spill, rec, False, found) && (found->cost < rec->cost))
+         spill->dropped++;
+      else {
+         if (materialize(search, rec))
+            return 1;
+         spill->loaded++;
+      }
+   
+      if (!read_record(spill, best))
+         *best = spill->runs[--spill->num_runs];
+   }
+   return 0;
+}
+
+_Bool spilled_duplicate(Search *search, u_int state_id) {
+   Spill *spill = search->spill;
+   State *state = get_state(search, state_id);
+   if ((spill->seen_length == 0) || (state->parent == NO_STATE))
+      return False;
+   
+   SpillRecord *key = spill->scratch;
+   SpillRecord *found = RECORD(spill->scratch, spill->record_size, 1);
+   make_record(search, state, state_hash(search, state), key);
+   if (find_seen(spill, key, False, found) && (found->cost <= state->cost_score)) {
+      spill->dropped++;
+      return True;
+   }
+   return False;
+}
+
+u_int restore_path(Search *search, u_int solution) {
+   Spill *spill = search->spill;
+   u_int size = spill->record_size;
+   
+   u_int top = solution;
+   while (get_state(search, top)->parent != NO_STATE)
+      top = get_state(search, top)->parent;
+   State *top_state = get_state(search, top);
+   if (top_state->cost_score == 0)
+      return solution;
+   
+   SpillRecord *key = spill->scratch;
+   SpillRecord *found = RECORD(spill->scratch, size, 1);
+   make_record(search, top_state, state_hash(search, top_state), key);
+   if (!find_seen(spill, key, False, found))
+      return NO_STATE;
+   top_state->move_from_parent = found->move;
+   
+   // every step back lowers the cost, so there are at most cost ancestors
+   u_int max_depth = top_state->cost_score;
+   SpillRecord *path = malloc((size_t) size * max_depth);
+   if (path == NULL)
+      return NO_STATE;
+   u_int depth = 0;
+   while (!found->root) {
+      key->hash = found->parent_hash;
+      if ((depth == max_depth) || !find_seen(spill, key, True, found)) {
+         free(path);
+         return NO_STATE;
+      }
+      memcpy(RECORD(path, size, depth++), found, size);
+   }
+   
+   u_int parent = NO_STATE;
+   while (depth-- > 0) {
+      SpillRecord *rec = RECORD(path, size, depth);
+      u_int id = alloc_arena(search->arena);
+      if (id == ARENA_NULL) {
+         free(path);
+         return NO_STATE;
+      }
+      State *state = get_state(search, id);
+      state->parent = parent;
+      state->move_from_parent = rec->move;
+      state->current_pos = rec->cursor;
+      memcpy(state->boxes, rec->boxes, sizeof(u_short) * rec->num_boxes);
+      state->cost_score = rec->cost;
+      state->heuristic_score = rec->heuristic;
+      parent = id;
+   }
+   get_state(search, top)->parent = parent;
+   
+   free(path);
+   return solution;
+}
+
+int init_spill(Search *search, const char *dir) {
+   Spill *spill = calloc(1, sizeof(Spill));
+   if (spill == NULL)
+      return 1;
+   search->spill = spill;
+   
+   spill->record_size = SPILL_RECORD_SIZE(search->level->num_boxes);
+   spill->scratch = malloc(spill->record_size * 2);
+   spill->dir = malloc(strlen(dir) + 1);
+   if ((spill->scratch == NULL) || (spill->dir == NULL))
+      return 1;
+   strcpy(spill->dir, dir);
+   
+   // fail now rather than once the memory runs out
+   FILE *file = new_file(spill);
+   if (file == NULL)
+      return 1;
+   fclose(file);
+   return 0;
+}
+
+void free_spill(Search *search) {
+   Spill *spill = search->spill;
+   if (spill == NULL)
+      return;
+   
+   for (u_int i = 0; i < spill->num_runs; i++) {
+      fclose(spill->runs[i].file);
+      free(spill->runs[i].head);
+   }
+   free(spill->runs);
+   if (spill->seen != NULL)
+      fclose(spill->seen);
+   free(spill->scratch);
+   free(spill->dir);
+   free(spill);
+   search->spill = NULL;
+}
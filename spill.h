@@ -0,0 +1,70 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sokoban.h"
+
+#define SPILL_KEEP_FRACTION 4    // the frontier kept in memory after a spill takes at most 1/4 of the limit
+#define SPILL_CHUNK_FRACTION 8   // the states are sorted in chunks of 1/8 of the limit before they are written
+#define SPILL_LOAD_BATCH 4096    // states merged back from the runs at a time
+
+// a state on disk: the boxes are sorted so that equal states have equal records
+typedef struct {
+   uint64_t hash;
+   uint64_t parent_hash;   // 0 for the root
+   u_int cost;
+   u_int heuristic;
+   u_short cursor;
+   u_short num_boxes;
+   u_char move;
+   u_char root;
+   u_short boxes[];
+} SpillRecord;
+
+#define SPILL_RECORD_SIZE(num_boxes) ((sizeof(SpillRecord) + sizeof(u_short) * (num_boxes) + 7) & ~7U)
+
+// a file of records sorted by f, read back one record at a time
+typedef struct {
+   FILE *file;
+   SpillRecord *head;      // next record of the run
+} Run;
+
+// the states of a search that outgrew its memory limit, see spill.c
+typedef struct spill {
+   char *dir;
+   u_int record_size;
+   
+   Run *runs;              // frontier states waiting on disk
+   u_int num_runs;
+   u_int runs_capacity;
+   
+   FILE *seen;             // every state written so far at its lowest cost, sorted by state
+   unsigned long seen_length;
+   
+   SpillRecord *scratch;
+   
+   u_int spills;
+   unsigned long written;
+   unsigned long loaded;
+   unsigned long dropped;  // states found on disk at a lower cost
+} Spill;
+
+// spilled files are created in dir and deleted as soon as they are opened
+int init_spill(Search *search, const char *dir);
+
+// writes every state of search to disk and starts over with only the best part of the frontier in memory
+int spill_states(Search *search);
+
+// moves states from the runs into the frontier while the runs hold better states than it
+int refill_frontier(Search *search);
+
+// whether the state just removed from the frontier was reached at no higher cost before a spill
+_Bool spilled_duplicate(Search *search, u_int state_id);
+
+// copies the ancestors of the solution left on disk back in the arena, returns the solution or NO_STATE
+u_int restore_path(Search *search, u_int solution);
+
+void free_spill(Search *search);
+
+#endif
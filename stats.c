@@ -0,0 +1,88 @@
+/*
+ * stats.c Copyright (C) 2019 Orpheas van Rooij
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime
+
+#include <time.h>
+#include "stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TICKS_UNIT "cycles"
+#else
+#define TICKS_UNIT "ns"
+#endif
+
+uint64_t stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+   return __builtin_ia32_rdtsc();
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void merge_stats(Stats *stats, Stats *from) {
+   stats->generated += from->generated;
+   stats->expanded += from->expanded;
+   stats->reopened += from->reopened;
+   stats->duplicates_open += from->duplicates_open;
+   stats->duplicates_closed += from->duplicates_closed;
+   stats->deadlock_pruned += from->deadlock_pruned;
+   stats->freeze_pruned += from->freeze_pruned;
+   stats->corral_pruned += from->corral_pruned;
+   stats->peak_frontier += from->peak_frontier;
+   stats->peak_closed += from->peak_closed;
+   stats->heuristic_ticks += from->heuristic_ticks;
+   stats->deadlock_ticks += from->deadlock_ticks;
+   stats->duplicate_ticks += from->duplicate_ticks;
+   stats->queue_ticks += from->queue_ticks;
+}
+
+// writes str as a json string, quotes included
+static void print_json_string(FILE *file, const char *str) {
+   fputc('"', file);
+   for (; *str != 0; str++) {
+      unsigned char c = *str;
+      if ((c == '"') || (c == '\\'))
+         fprintf(file, "\\%c", c);
+      else if (c < 0x20)
+         fprintf(file, "\\u%04x", c);
+      else
+         fputc(c, file);
+   }
+   fputc('"', file);
+}
+
+void print_stats(FILE *file, Stats *stats, const char *name, u_int solution_length, double seconds) {
+   fprintf(file, "{");
+   if (name != NULL) {
+      fprintf(file, "\"puzzle\": ");
+      print_json_string(file, name);
+      fprintf(file, ", ");
+   }
+   fprintf(file, "\"solution_length\": %u, \"seconds\": %.3f, "
+           "\"nodes_generated\": %lu, \"nodes_expanded\": %lu, \"nodes_reopened\": %lu, "
+           "\"duplicates_open\": %lu, \"duplicates_closed\": %lu, \"deadlock_pruned\": %lu, "
+           "\"freeze_pruned\": %lu, \"corral_pruned\": %lu, \"peak_frontier\": %u, \"peak_closed\": %u, \"timer_unit\": \"%s\", "
+           "\"heuristic_time\": %llu, \"deadlock_time\": %llu, \"duplicate_time\": %llu, \"queue_time\": %llu}\n",
+           solution_length, seconds, stats->generated, stats->expanded, stats->reopened,
+           stats->duplicates_open, stats->duplicates_closed, stats->deadlock_pruned,
+           stats->freeze_pruned, stats->corral_pruned, stats->peak_frontier, stats->peak_closed, TICKS_UNIT,
+           (unsigned long long) stats->heuristic_ticks, (unsigned long long) stats->deadlock_ticks,
+           (unsigned long long) stats->duplicate_ticks, (unsigned long long) stats->queue_ticks);
+}
@@ -0,0 +1,62 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "types.h"
+
+// counters and phase timers of a search, reported by --stats=json.
+// the timers only run when the report was asked for, building with -DNO_STATS leaves out both
+typedef struct {
+   _Bool enabled;
+   
+   unsigned long generated;         // children made by the expansions, deadlocked ones included
+   unsigned long expanded;
+   unsigned long reopened;          // expanded states put back in the frontier for a cheaper path
+   unsigned long duplicates_open;   // children found in the state table and still in the frontier
+   unsigned long duplicates_closed; // children found in the state table and already expanded
+   unsigned long deadlock_pruned;
+   unsigned long freeze_pruned;     // the ones of deadlock_pruned caught by the freeze check
+   unsigned long corral_pruned;     // pushes left out for the pushes of a PI-corral
+   u_int peak_frontier;
+   u_int peak_closed;
+   
+   // ticks of stats_ticks spent in each phase
+   uint64_t heuristic_ticks;
+   uint64_t deadlock_ticks;
+   uint64_t duplicate_ticks;
+   uint64_t queue_ticks;
+} Stats;
+
+#ifdef NO_STATS
+#define STATS_ADD(search, counter) ((void) 0)
+#define STATS_PEAK(search, peak, value) ((void) 0)
+#define STATS_EXPAND(search) ((void) 0)
+#define STATS_START(search) ((uint64_t) 0)
+#define STATS_STOP(search, timer, start) ((void) (start))
+#else
+#define STATS_ADD(search, counter) ((search)->stats.counter++)
+#define STATS_PEAK(search, peak, value) \
+   do { if ((value) > (search)->stats.peak) (search)->stats.peak = (value); } while (0)
+// an expansion, with the sizes of the frontier and of the expanded states before it
+#define STATS_EXPAND(search) \
+   do { \
+      (search)->stats.expanded++; \
+      STATS_PEAK(search, peak_frontier, (search)->states->length); \
+      STATS_PEAK(search, peak_closed, (search)->table->length - (search)->states->length); \
+   } while (0)
+#define STATS_START(search) ((search)->stats.enabled ? stats_ticks() : 0)
+#define STATS_STOP(search, timer, start) \
+   do { if ((search)->stats.enabled) (search)->stats.timer += stats_ticks() - (start); } while (0)
+#endif
+
+// cycle counter where there is one, nanoseconds otherwise
+uint64_t stats_ticks(void);
+
+// adds the counters and timers of from to stats, the peaks add up as the searches ran side by side
+void merge_stats(Stats *stats, Stats *from);
+
+// writes stats as a json object on one line, with the name of the puzzle unless it is NULL
+void print_stats(FILE *file, Stats *stats, const char *name, u_int solution_length, double seconds);
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ * symmetry.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Symmetric state pruning. The rotations and mirrors of the level that map its walls and goal positions
+ * onto themselves are found when the search is set up. A state and its images are the same distance
+ * from the goal, so only the first one reached is kept: states are stored under the lowest hash of their
+ * images, and a child is a duplicate when a stored state is one of its images.
+ * 
+ * A stored state reached again through a cheaper image keeps its cells and takes the new parent, along
+ * with the symmetry from the child to itself, in the high bits of move_from_parent. The moves of the
+ * path are taken back through those symmetries once a solution is found (see unfold_path).
+ * 
+ * The symmetries are looked for in the smallest rectangle holding the floor the goal positions are on,
+ * any wall or decoration outside of it doesn't matter.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "symmetry.h"
+#include "push.h"
+
+// move directions as (row, column) steps, in the order of the cell offsets
+static const int MOVE_STEPS[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+// candidate t of the 8 rotations and mirrors of a height x width rectangle, the last 4 swap its sides
+static void transform(u_int t, int height, int width, int x, int y, int *tx, int *ty) {
+   switch (t) {
+      case 0: *tx = x; *ty = y; break;
+      case 1: *tx = x; *ty = width - 1 - y; break;
+      case 2: *tx = height - 1 - x; *ty = y; break;
+      case 3: *tx = height - 1 - x; *ty = width - 1 - y; break;
+      case 4: *tx = y; *ty = x; break;
+      case 5: *tx = width - 1 - y; *ty = height - 1 - x; break;
+      case 6: *tx = y; *ty = height - 1 - x; break;
+      default: *tx = width - 1 - y; *ty = x; break;
+   }
+}
+
+// whether a and b map the num_inner cells of inner the same way as c after d (d NULL for a alone)
+static _Bool same_images(u_short *a, u_short *b, u_short *d, u_short *inner, u_int num_inner) {
+   for (u_int i = 0; i < num_inner; i++)
+      if (a[inner[i]] != (d == NULL ? b[inner[i]] : b[d[inner[i]]]))
+         return False;
+   return True;
+}
+
+void free_symmetry(Search *search) {
+   Symmetry *sym = search->symmetry;
+   if (sym == NULL)
+      return;
+   for (u_int t = 0; t < sym->count; t++)
+      free(sym->cells[t]);
+   free(sym);
+   search->symmetry = NULL;
+}
+
+int init_symmetry(Search *search) {
+   Level *level = search->level;
+   u_int num_cells = level->num_cells;
+   search->symmetry = NULL;
+   if (level->num_boxes == 0)
+      return 0;
+   
+   u_char *inside = calloc(num_cells, sizeof(u_char));
+   u_short *inner = malloc(sizeof(u_short) * num_cells);
+   Symmetry *sym = calloc(1, sizeof(Symmetry));
+   if ((inside == NULL) || (inner == NULL) || (sym == NULL)) {
+      free(inside);
+      free(inner);
+      free(sym);
+      return 1;
+   }
+   
+   // the floor the goal positions are on, boxes left out, and the rectangle holding it
+   u_int num_inner = 0, head = 0;
+   u_short goal = level_cell(level, &level->goal_positions[0]);
+   u_int min_x = goal / level->width, max_x = min_x, min_y = goal % level->width, max_y = min_y;
+   inner[num_inner++] = goal;
+   inside[goal] = 1;
+   while (head < num_inner) {
+      u_short cell = inner[head++];
+      u_int x = cell / level->width, y = cell % level->width;
+      if (x < min_x) min_x = x;
+      if (x > max_x) max_x = x;
+      if (y < min_y) min_y = y;
+      if (y > max_y) max_y = y;
+      for (int mv = 0; mv < 4; mv++) {
+         u_short next = cell + level->offsets[mv];
+         if (!level->walls[next] && !inside[next]) {
+            inside[next] = 1;
+            inner[num_inner++] = next;
+         }
+      }
+   }
+   
+   int height = max_x - min_x + 1, width = max_y - min_y + 1;
+   int failed = 0;
+   for (u_int t = 0; (t < MAX_SYMMETRIES) && !failed; t++) {
+      if ((t >= 4) && (height != width))
+         break;
+      u_short *cells = malloc(sizeof(u_short) * num_cells);
+      if (cells == NULL) {
+         failed = 1;
+         break;
+      }
+      for (u_int i = 0; i < num_cells; i++)
+         cells[i] = i;
+      
+      _Bool valid = True;
+      for (u_int i = 0; valid && (i < num_inner); i++) {
+         int tx, ty;
+         transform(t, height, width, inner[i] / level->width - min_x, inner[i] % level->width - min_y, &tx, &ty);
+         u_short image = (tx + min_x) * level->width + ty + min_y;
+         valid = inside[image] && ((level->grid[inner[i]] == '.') == (level->grid[image] == '.'));
+         cells[inner[i]] = image;
+      }
+      // a floor of one row or column is left alone by some of the mirrors
+      for (u_int s = 0; valid && (s < sym->count); s++)
+         valid = !same_images(cells, sym->cells[s], NULL, inner, num_inner);
+      if (!valid) {
+         free(cells);
+         continue;
+      }
+      
+      for (int mv = 0; mv < 4; mv++) {
+         int x0, y0, x1, y1;
+         transform(t, height, width, 0, 0, &x0, &y0);
+         transform(t, height, width, MOVE_STEPS[mv][0], MOVE_STEPS[mv][1], &x1, &y1);
+         for (int image = 0; image < 4; image++)
+            if ((x1 - x0 == MOVE_STEPS[image][0]) && (y1 - y0 == MOVE_STEPS[image][1]))
+               sym->moves[sym->count][mv] = image;
+      }
+      sym->cells[sym->count++] = cells;
+   }
+   
+   // the symmetries found make a group, so every composition and inverse is one of them
+   for (u_int a = 0; !failed && (a < sym->count); a++)
+      for (u_int b = 0; b < sym->count; b++)
+         for (u_int c = 0; c < sym->count; c++)
+            if (same_images(sym->cells[c], sym->cells[a], sym->cells[b], inner, num_inner)) {
+               sym->compose[a][b] = c;
+               if (c == 0)
+                  sym->inverse[a] = b;
+            }
+   
+   free(inside);
+   free(inner);
+   search->symmetry = sym;
+   if (failed || (sym->count == 1))
+      free_symmetry(search);
+   return failed;
+}
+
+uint64_t symmetric_hash(Search *search, u_short cursor, u_short *cells) {
+   Symmetry *sym = search->symmetry;
+   Zobrist *zobrist = &search->zobrist;
+   _Bool push_mode = (search->expand_func == make_push);
+   uint64_t lowest = UINT64_MAX;
+   
+   for (u_int t = 0; t < sym->count; t++) {
+      u_short *image = sym->cells[t];
+      uint64_t hash = push_mode ? 0 : zobrist->cursor[image[cursor]];
+      for (u_int i = 0; i < search->level->num_boxes; i++)
+         hash ^= zobrist->boxes[image[cells[i]]];
+      if (hash < lowest)
+         lowest = hash;
+   }
+   return lowest;
+}
+
+// child looked up in the state table through its images
+typedef struct {
+   Search *search;
+   u_short cursor;
+   u_short *cells;
+   u_char symmetry;        // set to the image found
+} ImageKey;
+
+static int equal_image(u_int stored_state, void *image_key) {
+   ImageKey *key = image_key;
+   Search *search = key->search;
+   Symmetry *sym = search->symmetry;
+   State *state = get_state(search, stored_state);
+   u_int num_boxes = search->level->num_boxes;
+   _Bool push_mode = (search->expand_func == make_push);
+   
+   for (u_int t = 0; t < sym->count; t++) {
+      u_short *image = sym->cells[t];
+      
+      // a push mode state is the same when the image of the child region holds its cursor
+      if (push_mode ? (search->visited[sym->cells[sym->inverse[t]][state->current_pos]] != search->stamp) :
+                      (image[key->cursor] != state->current_pos))
+         continue;
+      
+      _Bool identical = True;
+      for (u_int i = 0; identical && (i < num_boxes); i++) {
+         identical = False;
+         for (u_int j = 0; j < num_boxes; j++)
+            if (image[key->cells[j]] == state->boxes[i]) {
+               identical = True;
+               break;
+            }
+      }
+      if (identical) {
+         key->symmetry = t;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+u_int symmetric_duplicate(Search *search, uint64_t *hash, u_short cursor, u_short *cells, u_char *symmetry) {
+   ImageKey key = { search, cursor, cells, 0 };
+   *hash = symmetric_hash(search, cursor, cells);
+   u_int identical = lookup_table(search->table, *hash, &key, equal_image);
+   
+   *symmetry = key.symmetry;
+   if ((identical != NO_STATE) && (key.symmetry != 0))
+      search->symmetry->mirrored++;
+   return identical;
+}
+
+u_int unfold_path(Search *search, u_int solution) {
+   Symmetry *sym = search->symmetry;
+   u_int num_boxes = search->level->num_boxes;
+   
+   u_int depth = 0;
+   _Bool mirrored = False;
+   for (u_int id = solution; id != NO_STATE; id = get_state(search, id)->parent) {
+      mirrored |= (get_state(search, id)->move_from_parent >> MOVE_BITS) != 0;
+      depth++;
+   }
+   if (!mirrored)
+      return solution;
+   
+   u_int *path = malloc(sizeof(u_int) * depth);
+   if (path == NULL)
+      return NO_STATE;
+   u_int i = depth;
+   for (u_int id = solution; id != NO_STATE; id = get_state(search, id)->parent)
+      path[--i] = id;
+   
+   // applied takes the stored state to the one the moves so far lead to, the root is stored as it is
+   u_int parent = path[0];
+   u_char applied = 0;
+   for (i = 1; i < depth; i++) {
+      u_int copy_id = alloc_arena(search->arena);
+      if (copy_id == ARENA_NULL) {
+         free(path);
+         return NO_STATE;
+      }
+      
+      State *stored = get_state(search, path[i]);
+      State *copy = get_state(search, copy_id);
+      u_char move = stored->move_from_parent & MOVE_MASK;
+      u_char symmetry = stored->move_from_parent >> MOVE_BITS;
+      
+      copy->move_from_parent = sym->moves[applied][move];
+      applied = sym->compose[applied][sym->inverse[symmetry]];
+      copy->parent = parent;
+      copy->cost_score = stored->cost_score;
+      copy->heuristic_score = stored->heuristic_score;
+      copy->current_pos = sym->cells[applied][stored->current_pos];
+      for (u_int b = 0; b < num_boxes; b++)
+         copy->boxes[b] = sym->cells[applied][stored->boxes[b]];
+      parent = copy_id;
+   }
+   free(path);
+   return parent;
+}
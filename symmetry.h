@@ -0,0 +1,39 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "sokoban.h"
+
+#define MAX_SYMMETRIES 8   // the rotations and mirrors of a square
+
+// rotations and mirrors mapping the walls and goal positions of the level onto themselves.
+// symmetry 0 is the identity
+typedef struct symmetry {
+   u_int count;
+   u_short *cells[MAX_SYMMETRIES];        // cells[t][cell]: image of cell by symmetry t
+   u_char moves[MAX_SYMMETRIES][4];       // image of each move direction
+   u_char inverse[MAX_SYMMETRIES];
+   u_char compose[MAX_SYMMETRIES][MAX_SYMMETRIES];   // compose[a][b]: b followed by a
+   unsigned long mirrored;                // children found as the image of a stored state
+} Symmetry;
+
+// sets search->symmetry to the symmetries of the level, or to NULL if the identity is the only one
+int init_symmetry(Search *search);
+
+void free_symmetry(Search *search);
+
+// the lowest hash of the images of a state, the same for a state and all its images.
+// in push mode the cursor is left out, it stands for a whole region which images don't keep normalized
+uint64_t symmetric_hash(Search *search, u_short cursor, u_short *cells);
+
+/*
+ * looks up a state of the table that is an image of the child, the cursor region of a push mode child
+ * has to be the last one flood filled. hash is set to the symmetric hash of the child and symmetry
+ * to the symmetry taking the child to the stored state
+ */
+u_int symmetric_duplicate(Search *search, uint64_t *hash, u_short cursor, u_short *cells, u_char *symmetry);
+
+// copies the path to solution with every state taken back from the image stored to the one the moves
+// lead to, returns the copy of solution or NO_STATE if out of memory
+u_int unfold_path(Search *search, u_int solution);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * table.c Copyright (C) 2019 Orpheas van Rooij
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+
+// the table is grown once it is more than 1/2 full, keeping probe sequences short
+#define MAX_LOAD_NUM 1
+#define MAX_LOAD_DEN 2
+
+static u_int table_hash(uint64_t hash) {
+   return hash >> 32;
+}
+
+static int grow_table(Table *ptr) {
+   u_int new_capacity = ptr->capacity * 2;
+   Entry *new_entries = malloc(sizeof(Entry) * new_capacity);
+   if (new_entries == NULL)
+      return 1;
+   for (u_int i = 0; i < new_capacity; i++)
+      new_entries[i].index = TABLE_EMPTY;
+   
+   u_int mask = new_capacity - 1;
+   for (u_int i = 0; i < ptr->capacity; i++) {
+      if (ptr->entries[i].index == TABLE_EMPTY)
+         continue;
+      
+      u_int slot = ptr->entries[i].hash & mask;
+      while (new_entries[slot].index != TABLE_EMPTY)
+         slot = (slot + 1) & mask;
+      new_entries[slot] = ptr->entries[i];
+   }
+   
+   free(ptr->entries);
+   ptr->entries = new_entries;
+   ptr->capacity = new_capacity;
+   return 0;
+}
+
+u_int lookup_table(Table *ptr, uint64_t hash, void *key, int (*equals)(u_int, void *)) {
+   u_int check = table_hash(hash);
+   u_int mask = ptr->capacity - 1;
+   u_int slot = check & mask;
+   u_int probe = 1;
+   
+   ptr->lookups++;
+   while (ptr->entries[slot].index != TABLE_EMPTY) {
+      if ((ptr->entries[slot].hash == check) && equals(ptr->entries[slot].index, key))
+         break;
+      slot = (slot + 1) & mask;
+      probe++;
+   }
+   
+   ptr->probes += probe;
+   if (probe > ptr->max_probe)
+      ptr->max_probe = probe;
+   
+   return ptr->entries[slot].index;
+}
+
+int insert_table(Table *ptr, uint64_t hash, u_int index) {
+   if (index == TABLE_EMPTY)
+      return 1;
+   
+   if ((ptr->length + 1) * MAX_LOAD_DEN > ptr->capacity * MAX_LOAD_NUM)
+      if (grow_table(ptr))
+         return 1;
+   
+   u_int check = table_hash(hash);
+   u_int mask = ptr->capacity - 1;
+   u_int slot = check & mask;
+   while (ptr->entries[slot].index != TABLE_EMPTY)
+      slot = (slot + 1) & mask;
+   
+   ptr->entries[slot].hash = check;
+   ptr->entries[slot].index = index;
+   ptr->length++;
+   return 0;
+}
+
+void clear_table(Table *ptr) {
+   for (u_int i = 0; i < ptr->capacity; i++)
+      ptr->entries[i].index = TABLE_EMPTY;
+   ptr->length = 0;
+   ptr->lookups = 0;
+   ptr->probes = 0;
+   ptr->max_probe = 0;
+}
+
+double load_factor_table(Table *ptr) {
+   return (double) ptr->length / ptr->capacity;
+}
+
+size_t size_table(Table *ptr) {
+   return sizeof(Table) + (size_t) ptr->capacity * sizeof(Entry);
+}
+
+void free_table(Table *ptr) {
+   free(ptr->entries);
+   free(ptr);
+}
+
+int init_table(Table **ptr, u_int capacity) {
+   *ptr = malloc(sizeof(Table));
+   if (*ptr == NULL)
+      return 1;
+   
+   // round the capacity up to a power of 2 so that the hash can be masked
+   u_int real_capacity = 16;
+   while (real_capacity < capacity)
+      real_capacity *= 2;
+   
+   (*ptr)->entries = malloc(sizeof(Entry) * real_capacity);
+   if ((*ptr)->entries == NULL) {
+      free(*ptr);
+      *ptr = NULL;
+      return 1;
+   }
+   for (u_int i = 0; i < real_capacity; i++)
+      (*ptr)->entries[i].index = TABLE_EMPTY;
+   
+   (*ptr)->capacity = real_capacity;
+   (*ptr)->length = 0;
+   (*ptr)->lookups = 0;
+   (*ptr)->probes = 0;
+   (*ptr)->max_probe = 0;
+   return 0;
+}
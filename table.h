@@ -0,0 +1,48 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include "types.h"
+
+#define TABLE_EMPTY UINT_MAX
+
+// the items themselves live elsewhere (eg. in an arena), the table only keeps their index
+// together with the upper 32 bits of their hash, which both pick the slot and filter out mismatches
+typedef struct {
+   u_int hash;
+   u_int index;
+} Entry;
+
+// open addressing hash table with linear probing, the capacity is always a power of 2
+// probe counters are always kept so that they can be reported by the caller
+typedef struct {
+   Entry *entries;
+   u_int capacity;
+   u_int length;
+   unsigned long lookups;
+   unsigned long probes;
+   u_int max_probe;
+} Table;
+
+int init_table(Table **ptr, u_int capacity);
+
+// equals function should return 1 if the stored item matches the key, 0 otherwise
+// returns the index of the stored item or TABLE_EMPTY
+u_int lookup_table(Table *ptr, uint64_t hash, void *key, int (*equals)(u_int, void *));
+
+// no check for duplicates is made, use lookup_table first
+int insert_table(Table *ptr, uint64_t hash, u_int index);
+
+// removes every entry, keeping the capacity reached so far
+void clear_table(Table *ptr);
+
+double load_factor_table(Table *ptr);
+
+// total bytes held by the table
+size_t size_table(Table *ptr);
+
+void free_table(Table *ptr);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+typedef unsigned char u_char;
+typedef unsigned short u_short;
+typedef unsigned int u_int;
+
+#endif